@@ -0,0 +1,199 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "affinity.h"
+
+static const char *placementNames[] = {"none", "oss", "spread", "sibling"};
+
+int onlineCpus(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+int pinThread(int cpu) {
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+
+int currentCpu(void) {
+    return sched_getcpu();
+}
+
+int placementByName(const char *name) {
+    for (int i = 0; i < (int)(sizeof(placementNames) / sizeof(placementNames[0])); i++) {
+        if (strcmp(name, placementNames[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *placementName(int policy) {
+    return placementNames[policy];
+}
+
+/* Parse "0-3,6" into set; -1 if it isn't a CPU list. */
+static int parseCpuList(const char *list, cpu_set_t *set) {
+    const char *p = list;
+
+    CPU_ZERO(set);
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p || first < 0) {
+            return -1;
+        }
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) {
+                return -1;
+            }
+        }
+        if (last >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, set);
+        }
+        if (*end == ',') {
+            end++;
+        } else if (*end && *end != '\n') {
+            return -1;
+        } else {
+            break;
+        }
+        p = end;
+    }
+    return 0;
+}
+
+/* The lowest other CPU sharing cpu's core, or -1 without SMT. */
+static int siblingOf(int cpu) {
+    char path[128], line[256];
+    cpu_set_t siblings;
+    int sibling = -1;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    if (fgets(line, sizeof(line), file) && parseCpuList(line, &siblings) == 0) {
+        for (int i = 0; i < CPU_SETSIZE && sibling < 0; i++) {
+            if (i != cpu && CPU_ISSET(i, &siblings)) {
+                sibling = i;
+            }
+        }
+    }
+    fclose(file);
+    return sibling;
+}
+
+int placementInit(Placement *place, int policy, const char *cpuList) {
+    cpu_set_t allowed, set;
+
+    memset(place, 0, sizeof(*place));
+    place->policy = policy;
+    place->ossCpu = -1;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+        perror("sched_getaffinity failed");
+        return -1;
+    }
+    if (cpuList) {
+        if (parseCpuList(cpuList, &set) == -1) {
+            fprintf(stderr, "Error: '%s' is not a CPU list like 0-3,6.\n", cpuList);
+            return -1;
+        }
+        CPU_AND(&set, &set, &allowed);
+    } else {
+        set = allowed;
+    }
+    int count = CPU_COUNT(&set);
+    if (count == 0) {
+        fprintf(stderr, "Error: none of the CPUs in '%s' are available.\n", cpuList);
+        return -1;
+    }
+    place->cpus = malloc(count * sizeof(int));
+    place->workerCpus = malloc(count * sizeof(int));
+    if (!place->cpus || !place->workerCpus) {
+        perror("malloc failed");
+        return -1;
+    }
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            place->cpus[place->cpuCount++] = cpu;
+        }
+    }
+    if (policy == PLACE_NONE) {
+        return 0;
+    }
+    for (int i = 0; i < place->cpuCount; i++) {
+        int cpu = place->cpus[i];
+        if (place->ossCpu < 0) {
+            place->ossCpu = cpu;
+        } else {
+            place->workerCpus[place->workerCount++] = cpu;
+        }
+    }
+    /* With a single CPU there is nowhere else to put the workers. */
+    if (place->workerCount == 0) {
+        place->workerCpus[place->workerCount++] = place->ossCpu;
+    }
+    if (policy == PLACE_SIBLING) {
+        int sibling = siblingOf(place->ossCpu);
+        place->workerCpus[0] = sibling >= 0 ? sibling : place->ossCpu;
+        place->workerCount = 1;
+    }
+    return 0;
+}
+
+int placeOss(const Placement *place) {
+    return place->policy == PLACE_NONE ? 0 : pinThread(place->ossCpu);
+}
+
+int placeWorker(const Placement *place, int slot) {
+    cpu_set_t set;
+
+    switch (place->policy) {
+        case PLACE_OSS:
+            /* Undo the pin the child inherited from oss. */
+            CPU_ZERO(&set);
+            for (int i = 0; i < place->workerCount; i++) {
+                CPU_SET(place->workerCpus[i], &set);
+            }
+            return sched_setaffinity(0, sizeof(set), &set);
+        case PLACE_SPREAD:
+        case PLACE_SIBLING:
+            return pinThread(place->workerCpus[slot % place->workerCount]);
+        default:
+            return 0;
+    }
+}
+
+void formatCpus(const int *cpus, int count, char *out, int size) {
+    int used = 0;
+
+    out[0] = '\0';
+    for (int i = 0; i < count && used < size; i++) {
+        int last = i;
+        while (last + 1 < count && cpus[last + 1] == cpus[last] + 1) {
+            last++;
+        }
+        if (last > i) {
+            used += snprintf(out + used, size - used, "%s%d-%d", used ? "," : "", cpus[i], cpus[last]);
+        } else {
+            used += snprintf(out + used, size - used, "%s%d", used ? "," : "", cpus[i]);
+        }
+        i = last;
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+/*
+ * CPU placement helpers. They live in their own file because the affinity
+ * calls need _GNU_SOURCE, which also makes <sys/msg.h> declare a struct
+ * msgbuf of its own that clashes with the one in shared.h.
+ */
+int onlineCpus(void);
+
+/* Pin the calling thread to one CPU. Returns -1 if the kernel refuses. */
+int pinThread(int cpu);
+
+/* The CPU the caller is running on right now, or -1. */
+int currentCpu(void);
+
+/*
+ * Where oss and its worker processes run (oss -a):
+ *   none     wherever the kernel puts them
+ *   oss      oss's main thread on one CPU, workers anywhere else in the set
+ *   spread   oss as above, workers round robin by slot over the rest of the set
+ *   sibling  oss as above, every worker on oss's SMT sibling, or on oss's
+ *            own CPU when it has none
+ */
+#define PLACE_NONE 0
+#define PLACE_OSS 1
+#define PLACE_SPREAD 2
+#define PLACE_SIBLING 3
+
+typedef struct {
+    int policy;
+    /* The whole set, lowest first, whatever the policy; oss's other threads go here. */
+    int *cpus;
+    int cpuCount;
+    /* -1 with PLACE_NONE. */
+    int ossCpu;
+    /* CPUs workers may use; with PLACE_SPREAD slot i gets workerCpus[i % count]. */
+    int *workerCpus;
+    int workerCount;
+} Placement;
+
+/* -1 if there is no policy by that name. */
+int placementByName(const char *name);
+const char *placementName(int policy);
+
+/*
+ * Work out a placement over the CPUs in cpuList ("0-3,6") that the caller
+ * may run on, or over all of those when it is NULL. Returns -1 with a message on stderr if the
+ * list is malformed or names no usable CPU.
+ */
+int placementInit(Placement *place, int policy, const char *cpuList);
+
+/* Pin the caller as oss. */
+int placeOss(const Placement *place);
+
+/* In a forked worker before exec: move it where slot's worker belongs. */
+int placeWorker(const Placement *place, int slot);
+
+/* "1-3,5" for messages; writes at most size bytes. */
+void formatCpus(const int *cpus, int count, char *out, int size);
+
+#endif
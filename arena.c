@@ -0,0 +1,95 @@
+#include "arena.h"
+
+/*
+ * After the header come the per-block next links and generations, then the
+ * blocks themselves, each starting on a cache line.
+ */
+typedef struct {
+    _Atomic unsigned int next;
+    _Atomic unsigned int generation;
+} BlockHeader;
+
+static BlockHeader *headers(PayloadArena *arena) {
+    return (BlockHeader *)arena->rest;
+}
+
+static size_t dataStart(unsigned int blockCount) {
+    return ((size_t)blockCount * sizeof(BlockHeader) + 63) / 64 * 64;
+}
+
+static char *blockData(PayloadArena *arena, unsigned int index) {
+    return arena->rest + dataStart(arena->blockCount) + (size_t)index * arena->blockSize;
+}
+
+size_t arenaSize(unsigned int blockSize, unsigned int blockCount) {
+    blockSize = (blockSize + 63) / 64 * 64;
+    return sizeof(PayloadArena) + dataStart(blockCount) + (size_t)blockSize * blockCount;
+}
+
+void arenaInit(PayloadArena *arena, unsigned int blockSize, unsigned int blockCount) {
+    arena->blockSize = (blockSize + 63) / 64 * 64;
+    arena->blockCount = blockCount;
+    for (unsigned int i = 0; i < blockCount; i++) {
+        atomic_init(&headers(arena)[i].next, i + 1 < blockCount ? i + 1 : ARENA_NONE);
+        atomic_init(&headers(arena)[i].generation, 1);
+    }
+    atomic_init(&arena->freeHead, blockCount > 0 ? 0 : ARENA_NONE);
+}
+
+int arenaAlloc(PayloadArena *arena, unsigned int length, PayloadHandle *handle) {
+    unsigned long long head = atomic_load(&arena->freeHead);
+    unsigned int index;
+
+    if (length > arena->blockSize) {
+        return -1;
+    }
+    do {
+        index = (unsigned int)head;
+        if (index == ARENA_NONE) {
+            return -1;
+        }
+        unsigned long long next = atomic_load(&headers(arena)[index].next);
+        unsigned long long tag = (head >> 32) + 1;
+        if (atomic_compare_exchange_weak(&arena->freeHead, &head, tag << 32 | next)) {
+            break;
+        }
+    } while (1);
+
+    handle->offset = (unsigned int)(blockData(arena, index) - arena->rest);
+    handle->length = length;
+    handle->generation = atomic_load(&headers(arena)[index].generation);
+    return 0;
+}
+
+static unsigned int blockIndex(PayloadArena *arena, const PayloadHandle *handle) {
+    size_t start = dataStart(arena->blockCount);
+    if (handle->offset < start) {
+        return ARENA_NONE;
+    }
+    unsigned int index = (handle->offset - start) / arena->blockSize;
+    return index < arena->blockCount ? index : ARENA_NONE;
+}
+
+void *arenaData(PayloadArena *arena, const PayloadHandle *handle) {
+    unsigned int index = blockIndex(arena, handle);
+    if (index == ARENA_NONE || atomic_load(&headers(arena)[index].generation) != handle->generation) {
+        return NULL;
+    }
+    return arena->rest + handle->offset;
+}
+
+int arenaRelease(PayloadArena *arena, const PayloadHandle *handle) {
+    unsigned int index = blockIndex(arena, handle);
+    unsigned int generation = handle->generation;
+
+    if (index == ARENA_NONE ||
+        !atomic_compare_exchange_strong(&headers(arena)[index].generation, &generation, generation + 1)) {
+        return -1;
+    }
+
+    unsigned long long head = atomic_load(&arena->freeHead);
+    do {
+        atomic_store(&headers(arena)[index].next, (unsigned int)head);
+    } while (!atomic_compare_exchange_weak(&arena->freeHead, &head, ((head >> 32) + 1) << 32 | index));
+    return 0;
+}
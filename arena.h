@@ -0,0 +1,49 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/*
+ * Shared-memory payload arena. Large message bodies are written once into a
+ * block here and only a PayloadHandle travels through the queue or ring; the
+ * receiver reads the bytes in place and releases the block when it is done.
+ *
+ * Blocks are all blockSize bytes and sit on a lock-free free list, so any
+ * attached process can allocate or release. Every release bumps the block's
+ * generation, which makes a handle to it stale: arenaData() then returns
+ * NULL and a second arenaRelease() fails instead of freeing someone else's
+ * buffer.
+ */
+typedef struct {
+    unsigned int offset;
+    unsigned int length;
+    unsigned int generation;
+} PayloadHandle;
+
+#define ARENA_NONE 0xffffffffu
+
+typedef struct {
+    unsigned int blockSize;
+    unsigned int blockCount;
+    /* Free list top: block index in the low 32 bits, an ABA tag above. */
+    _Alignas(64) _Atomic unsigned long long freeHead;
+    _Alignas(64) char rest[];
+} PayloadArena;
+
+/* Bytes needed for an arena of blockCount blocks of blockSize bytes. */
+size_t arenaSize(unsigned int blockSize, unsigned int blockCount);
+
+/* Lay out a fresh arena in memory of arenaSize() bytes, every block free. */
+void arenaInit(PayloadArena *arena, unsigned int blockSize, unsigned int blockCount);
+
+/* Reserve a block for length bytes. Returns -1 if it doesn't fit or none is free. */
+int arenaAlloc(PayloadArena *arena, unsigned int length, PayloadHandle *handle);
+
+/* Where the payload lives, or NULL if the handle has been released. */
+void *arenaData(PayloadArena *arena, const PayloadHandle *handle);
+
+/* Give the block back. Returns -1 if the handle was already released. */
+int arenaRelease(PayloadArena *arena, const PayloadHandle *handle);
+
+#endif
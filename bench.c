@@ -0,0 +1,599 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/shm.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+
+#include "affinity.h"
+#include "shared.h"
+#include "transport.h"
+
+/*
+ * IPC benchmark. Drives ./worker through the same handshake oss uses, with
+ * the clock frozen so workers never decide to leave, and prints one JSON
+ * object per concurrency level:
+ *   - fork-to-first-reply latency for each worker launch
+ *   - round-trip latency percentiles and a log2 histogram (ns)
+ *   - replies per second with every worker messaged each round
+ *
+ * With -a the benchmark and its workers are placed on CPUs the way oss -a
+ * places oss and its workers, to show what placement does to round trips.
+ *
+ * With -s it instead sweeps payload sizes and compares copying the payload
+ * through a SysV message against passing an arena handle, one JSON object
+ * per size.
+ */
+
+#define MAX_LEVELS 32
+#define HIST_BUCKETS 40
+
+SharedSegment *segment;
+int shmid = -1;
+const Transport *transport;
+int transportOpen;
+pid_t *pids;
+int *awaiting;
+long long *sentAt;
+int spawned;
+Placement placement;
+
+/* Payload sweep: a forked echo child, its private queue and the arena. */
+#define PAYLOAD_COPY 1
+#define PAYLOAD_HANDLE 2
+#define PAYLOAD_STOP 3
+#define PAYLOAD_ACK 4
+
+pid_t echoPid;
+volatile sig_atomic_t echoGone;
+int payloadQid = -1, arenaShmid = -1;
+PayloadArena *arena;
+
+struct payloadMsg {
+    long mtype;
+    char data[];
+};
+
+void cleanup(int signum) {
+    for (int i = 0; i < spawned; i++) {
+        if (pids[i] > 0) {
+            kill(pids[i], SIGTERM);
+        }
+    }
+    if (transportOpen) {
+        transport->close();
+    }
+    if (segment && segment != (void *)-1) {
+        shmdt(segment);
+    }
+    if (shmid != -1) {
+        shmctl(shmid, IPC_RMID, NULL);
+    }
+    if (echoPid > 0) {
+        kill(echoPid, SIGTERM);
+    }
+    if (payloadQid != -1) {
+        msgctl(payloadQid, IPC_RMID, NULL);
+    }
+    if (arenaShmid != -1) {
+        shmdt(arena);
+        shmctl(arenaShmid, IPC_RMID, NULL);
+    }
+    exit(signum == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+long long wallNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NANOS_PER_SEC + ts.tv_nsec;
+}
+
+void setup(int capacity) {
+    shmid = shmget(IPC_PRIVATE, segmentSize(capacity), IPC_CREAT | 0600);
+    if (shmid == -1) {
+        perror("shmget failed");
+        exit(EXIT_FAILURE);
+    }
+    char shmidStr[16];
+    snprintf(shmidStr, sizeof(shmidStr), "%d", shmid);
+    setenv(SEGMENT_ENV, shmidStr, 1);
+    segment = (SharedSegment *)shmat(shmid, NULL, 0);
+    if (segment == (void *)-1) {
+        perror("shmat failed");
+        cleanup(1);
+    }
+    segment->ossPid = getpid();
+    segment->transport = transport->id;
+    segment->capacity = capacity;
+    segment->outputEvery = OUTPUT_EDGES;
+    segment->arenaShmid = -1;
+    segment->statsShmid = -1;
+    segment->msqid = -1;
+    atomic_store(&segment->replyBell, 0);
+    atomic_store(&segment->bellSleepers, 0);
+    clockWrite(&segment->clock, 0);
+    transportOpen = 1;
+    if (transport->open(segment, capacity) == -1) {
+        perror("transport setup failed");
+        cleanup(1);
+    }
+}
+
+/* Start a worker that will outlive the run; its output goes to /dev/null. */
+pid_t spawn(int slot) {
+    char slotStr[10];
+    snprintf(slotStr, 10, "%d", slot);
+    transport->prepare(slot);
+    segment->slots[slot].info.startNanos = 0;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (transport->inherit) {
+            transport->inherit(slot);
+        }
+        if (placeWorker(&placement, slot) == -1) {
+            perror("placeWorker failed");
+        }
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) {
+            dup2(devnull, STDOUT_FILENO);
+        }
+        execl("./worker", "./worker", "1000000", "0", slotStr, (char *)NULL);
+        perror("execl failed");
+        exit(EXIT_FAILURE);
+    } else if (pid < 0) {
+        perror("fork failed");
+        cleanup(1);
+    }
+    return pid;
+}
+
+void sendTo(int slot) {
+    struct msgbuf msg = {0};
+    msg.mtype = toWorkerType(pids[slot]);
+    msg.mtext = MSG_TICK;
+    awaiting[slot] = 1;
+    sentAt[slot] = wallNanos();
+    if (transport->send(slot, &msg) == -1) {
+        perror("send failed");
+        cleanup(1);
+    }
+}
+
+/* Block until any worker we are waiting on answers; returns its slot. */
+int receiveAny(int count) {
+    struct msgbuf msg;
+    int attempts = 0;
+
+    if (transport->pollAny) {
+        while (1) {
+            if (transport->pollAny(&msg, 1) == -1) {
+                perror("receive failed");
+                cleanup(1);
+            }
+            for (int i = 0; i < count; i++) {
+                if (awaiting[i] && pids[i] == msg.mtype) {
+                    awaiting[i] = 0;
+                    return i;
+                }
+            }
+        }
+    }
+
+    while (1) {
+        unsigned int token = transport->arm ? transport->arm() : 0;
+        for (int i = 0; i < count; i++) {
+            int got = awaiting[i] ? transport->poll(i, pids[i], &msg) : 0;
+            if (got == -1) {
+                perror("receive failed");
+                cleanup(1);
+            } else if (got == 1) {
+                awaiting[i] = 0;
+                return i;
+            }
+        }
+        if (transport->wait && attempts >= RING_SPINS) {
+            transport->wait(token, 0);
+        } else {
+            ringBackoff(&attempts);
+        }
+    }
+}
+
+int compareLong(const void *a, const void *b) {
+    long long x = *(const long long *)a;
+    long long y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+long long percentile(long long *sorted, int count, double p) {
+    int index = (int)(p * (count - 1));
+    return sorted[index];
+}
+
+/* Move the clock past every deadline and give each worker one last tick. */
+void stopWorkers(int count) {
+    clockWrite(&segment->clock, 2000000 * NANOS_PER_SEC);
+    for (int i = 0; i < count; i++) {
+        sendTo(i);
+    }
+    for (int i = 0; i < count; i++) {
+        receiveAny(count);
+    }
+    for (int i = 0; i < count; i++) {
+        waitpid(pids[i], NULL, 0);
+        pids[i] = 0;
+    }
+    spawned = 0;
+    clockWrite(&segment->clock, 0);
+}
+
+void runLevel(int workers, int rounds) {
+    long long *launch = malloc(workers * sizeof(long long));
+    long long *rtt = malloc((size_t)workers * rounds * sizeof(long long));
+    long long hist[HIST_BUCKETS] = {0};
+    int samples = 0;
+
+    if (!launch || !rtt) {
+        perror("malloc failed");
+        cleanup(1);
+    }
+
+    for (int i = 0; i < workers; i++) {
+        long long start = wallNanos();
+        pids[i] = spawn(i);
+        spawned = i + 1;
+        sendTo(i);
+        receiveAny(workers);
+        launch[i] = wallNanos() - start;
+    }
+
+    /* Warm up caches and the scheduler before measuring. */
+    for (int r = 0; r < rounds / 10; r++) {
+        for (int i = 0; i < workers; i++) {
+            sendTo(i);
+        }
+        for (int i = 0; i < workers; i++) {
+            receiveAny(workers);
+        }
+    }
+
+    long long begin = wallNanos();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < workers; i++) {
+            sendTo(i);
+        }
+        for (int i = 0; i < workers; i++) {
+            int slot = receiveAny(workers);
+            long long ns = wallNanos() - sentAt[slot];
+            int bucket = 0;
+            while (bucket < HIST_BUCKETS - 1 && (1LL << (bucket + 1)) <= ns) {
+                bucket++;
+            }
+            hist[bucket]++;
+            rtt[samples++] = ns;
+        }
+    }
+    long long elapsed = wallNanos() - begin;
+
+    stopWorkers(workers);
+
+    qsort(launch, workers, sizeof(long long), compareLong);
+    qsort(rtt, samples, sizeof(long long), compareLong);
+
+    printf("{\"transport\":\"%s\",\"placement\":\"%s\",\"workers\":%d,\"rounds\":%d,\"round_trips\":%d,"
+           "\"msgs_per_sec\":%.0f,\"rtt_p50_ns\":%lld,\"rtt_p99_ns\":%lld,\"rtt_p999_ns\":%lld,"
+           "\"rtt_max_ns\":%lld,\"fork_to_first_p50_ns\":%lld,\"fork_to_first_max_ns\":%lld,"
+           "\"rtt_hist_log2_ns\":[",
+           transport->name, placementName(placement.policy), workers, rounds, samples,
+           samples / (elapsed / 1e9), percentile(rtt, samples, 0.50), percentile(rtt, samples, 0.99),
+           percentile(rtt, samples, 0.999), rtt[samples - 1], percentile(launch, workers, 0.50),
+           launch[workers - 1]);
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        printf("%s%lld", b ? "," : "", hist[b]);
+    }
+    printf("]}\n");
+    fflush(stdout);
+
+    free(launch);
+    free(rtt);
+}
+
+/*
+ * The echo child reads every payload it is sent, in the message or in the
+ * arena, and acknowledges it with a one-byte reply.
+ */
+void payloadEcho(int maxBytes) {
+    /* A handle message is sizeof(PayloadHandle) bytes whatever the payload size. */
+    size_t bufferBytes = maxBytes > (int)sizeof(PayloadHandle) ? (size_t)maxBytes : sizeof(PayloadHandle);
+    struct payloadMsg *msg = malloc(sizeof(struct payloadMsg) + bufferBytes);
+    unsigned long sum = 0;
+
+    if (!msg) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    while (1) {
+        ssize_t n = msgrcv(payloadQid, msg, bufferBytes, -PAYLOAD_STOP, 0);
+        if (n == -1) {
+            perror("echo msgrcv failed");
+            exit(EXIT_FAILURE);
+        }
+        if (msg->mtype == PAYLOAD_STOP) {
+            break;
+        }
+        const unsigned char *data = (unsigned char *)msg->data;
+        if (msg->mtype == PAYLOAD_HANDLE) {
+            PayloadHandle handle;
+            memcpy(&handle, msg->data, sizeof(handle));
+            data = arenaData(arena, &handle);
+            n = handle.length;
+            for (ssize_t i = 0; i < n; i++) {
+                sum += data[i];
+            }
+            arenaRelease(arena, &handle);
+        } else {
+            for (ssize_t i = 0; i < n; i++) {
+                sum += data[i];
+            }
+        }
+        msg->mtype = PAYLOAD_ACK;
+        msg->data[0] = (char)sum;
+        msgsnd(payloadQid, msg, 1, 0);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+/*
+ * The echo child died before it was told to stop. Removing the queue makes
+ * the parent's blocked msgrcv, or its next one, fail instead of waiting for
+ * an ack that will never come.
+ */
+void echoExited(int signum) {
+    echoGone = 1;
+    msgctl(payloadQid, IPC_RMID, NULL);
+}
+
+void setupPayload(int maxBytes) {
+    payloadQid = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+    if (payloadQid == -1) {
+        perror("msgget failed");
+        cleanup(1);
+    }
+    arenaShmid = shmget(IPC_PRIVATE, arenaSize(maxBytes, 4), IPC_CREAT | 0600);
+    if (arenaShmid == -1) {
+        perror("shmget failed");
+        cleanup(1);
+    }
+    arena = (PayloadArena *)shmat(arenaShmid, NULL, 0);
+    if (arena == (void *)-1) {
+        perror("shmat failed");
+        cleanup(1);
+    }
+    arenaInit(arena, maxBytes, 4);
+
+    signal(SIGCHLD, echoExited);
+    echoPid = fork();
+    if (echoPid == 0) {
+        payloadEcho(maxBytes);
+    } else if (echoPid < 0) {
+        perror("fork failed");
+        cleanup(1);
+    }
+}
+
+/* One payload round trip; returns its wall time, or -1 if the kernel refused the message. */
+long long payloadRoundTrip(struct payloadMsg *msg, int bytes, int useArena) {
+    long long start = wallNanos();
+    size_t size = bytes;
+
+    if (useArena) {
+        PayloadHandle handle;
+        if (arenaAlloc(arena, bytes, &handle) == -1) {
+            fprintf(stderr, "bench: payload arena exhausted\n");
+            cleanup(1);
+        }
+        memset(arenaData(arena, &handle), start & 0xff, bytes);
+        msg->mtype = PAYLOAD_HANDLE;
+        memcpy(msg->data, &handle, sizeof(handle));
+        size = sizeof(handle);
+    } else {
+        msg->mtype = PAYLOAD_COPY;
+        memset(msg->data, start & 0xff, bytes);
+    }
+    if (msgsnd(payloadQid, msg, size, 0) == -1) {
+        if (echoGone) {
+            fprintf(stderr, "bench: echo child exited\n");
+            cleanup(1);
+        } else if (useArena) {
+            perror("msgsnd failed");
+            cleanup(1);
+        }
+        return -1;
+    }
+    if (msgrcv(payloadQid, msg, 1, PAYLOAD_ACK, 0) == -1) {
+        if (echoGone) {
+            fprintf(stderr, "bench: echo child exited\n");
+        } else {
+            perror("msgrcv failed");
+        }
+        cleanup(1);
+    }
+    return wallNanos() - start;
+}
+
+/* Median round trip for each way of moving the payload, and what that is in MB/s. */
+void runPayloadLevel(int bytes, int rounds) {
+    struct payloadMsg *msg = malloc(sizeof(struct payloadMsg) + bytes + sizeof(PayloadHandle));
+    long long *copy = malloc(rounds * sizeof(long long));
+    long long *handle = malloc(rounds * sizeof(long long));
+    int copyFailed = 0;
+
+    if (!msg || !copy || !handle) {
+        perror("malloc failed");
+        cleanup(1);
+    }
+    for (int r = 0; r < rounds && !copyFailed; r++) {
+        copy[r] = payloadRoundTrip(msg, bytes, 0);
+        copyFailed = copy[r] == -1;
+    }
+    for (int r = 0; r < rounds; r++) {
+        handle[r] = payloadRoundTrip(msg, bytes, 1);
+    }
+    qsort(copy, rounds, sizeof(long long), compareLong);
+    qsort(handle, rounds, sizeof(long long), compareLong);
+
+    long long handleP50 = percentile(handle, rounds, 0.50);
+    printf("{\"payload_bytes\":%d,\"rounds\":%d,", bytes, rounds);
+    if (copyFailed) {
+        /* Larger than msgmax: a plain SysV message can't carry it at all. */
+        printf("\"copy_rtt_p50_ns\":null,\"copy_mb_per_sec\":null,");
+    } else {
+        long long copyP50 = percentile(copy, rounds, 0.50);
+        printf("\"copy_rtt_p50_ns\":%lld,\"copy_mb_per_sec\":%.1f,", copyP50, bytes / (copyP50 / 1e9) / 1e6);
+    }
+    printf("\"handle_rtt_p50_ns\":%lld,\"handle_mb_per_sec\":%.1f}\n", handleP50,
+           bytes / (handleP50 / 1e9) / 1e6);
+    fflush(stdout);
+
+    free(msg);
+    free(copy);
+    free(handle);
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-m %s] [-w 1,2,4,...] [-r rounds]\n"
+                    "          [-a none|oss|spread|sibling] [-C cpus] [-s 64,4096,...]\n", prog, transportNames());
+    fprintf(stderr, "  -m  message transport to measure (default sysv)\n");
+    fprintf(stderr, "  -w  comma-separated worker counts to sweep (default 1,2,4,8,16)\n");
+    fprintf(stderr, "  -r  measured rounds per level; every worker is messaged once a round (default 1000)\n");
+    fprintf(stderr, "  -a  place the benchmark and its workers on CPUs as oss -a does (default none)\n");
+    fprintf(stderr, "  -C  CPUs to place on, e.g. 0-3,6 (default all allowed)\n");
+    fprintf(stderr, "  -s  instead sweep these payload sizes in bytes, copied through SysV vs passed\n");
+    fprintf(stderr, "      by arena handle\n");
+}
+
+int main(int argc, char *argv[]) {
+    int levels[MAX_LEVELS] = {1, 2, 4, 8, 16};
+    int levelCount = 5;
+    int rounds = 1000;
+    int maxWorkers = 0;
+    int payloads[MAX_LEVELS];
+    int payloadCount = 0;
+    int maxPayload = 0;
+    int policy = PLACE_NONE;
+    const char *cpus = NULL;
+    int opt;
+
+    transport = transportById(TRANSPORT_SYSV);
+    while ((opt = getopt(argc, argv, "hm:w:r:s:a:C:")) != -1) {
+        switch (opt) {
+            case 'm':
+                transport = transportByName(optarg);
+                if (!transport) {
+                    fprintf(stderr, "Unknown transport '%s'\n", optarg);
+                    usage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'a':
+                policy = placementByName(optarg);
+                if (policy < 0) {
+                    fprintf(stderr, "Unknown placement '%s'\n", optarg);
+                    usage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'C':
+                cpus = optarg;
+                break;
+            case 'w':
+                levelCount = 0;
+                for (char *tok = strtok(optarg, ","); tok && levelCount < MAX_LEVELS; tok = strtok(NULL, ",")) {
+                    levels[levelCount] = atoi(tok);
+                    if (levels[levelCount] <= 0) {
+                        fprintf(stderr, "Error: worker counts must be positive.\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    levelCount++;
+                }
+                break;
+            case 's':
+                for (char *tok = strtok(optarg, ","); tok && payloadCount < MAX_LEVELS; tok = strtok(NULL, ",")) {
+                    payloads[payloadCount] = atoi(tok);
+                    if (payloads[payloadCount] <= 0) {
+                        fprintf(stderr, "Error: payload sizes must be positive.\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    if (payloads[payloadCount] > maxPayload) {
+                        maxPayload = payloads[payloadCount];
+                    }
+                    payloadCount++;
+                }
+                break;
+            case 'r':
+                rounds = atoi(optarg);
+                if (rounds <= 0) {
+                    fprintf(stderr, "Error: rounds must be positive.\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+    }
+
+    if (placementInit(&placement, policy, cpus) == -1) {
+        exit(EXIT_FAILURE);
+    }
+    if (placeOss(&placement) == -1) {
+        perror("placeOss failed");
+    }
+
+    if (payloadCount > 0) {
+        signal(SIGINT, cleanup);
+        setupPayload(maxPayload);
+        for (int i = 0; i < payloadCount; i++) {
+            fprintf(stderr, "bench: %d byte payloads\n", payloads[i]);
+            runPayloadLevel(payloads[i], rounds);
+        }
+        signal(SIGCHLD, SIG_DFL);
+        struct payloadMsg stop = {PAYLOAD_STOP};
+        msgsnd(payloadQid, &stop, 0, 0);
+        waitpid(echoPid, NULL, 0);
+        echoPid = 0;
+        cleanup(0);
+    }
+
+    for (int i = 0; i < levelCount; i++) {
+        if (levels[i] > maxWorkers) {
+            maxWorkers = levels[i];
+        }
+    }
+
+    pids = calloc(maxWorkers, sizeof(pid_t));
+    awaiting = calloc(maxWorkers, sizeof(int));
+    sentAt = calloc(maxWorkers, sizeof(long long));
+    if (!pids || !awaiting || !sentAt) {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+
+    signal(SIGINT, cleanup);
+    setup(maxWorkers);
+
+    for (int i = 0; i < levelCount; i++) {
+        fprintf(stderr, "bench: %s, %d workers\n", transport->name, levels[i]);
+        runLevel(levels[i], rounds);
+    }
+
+    cleanup(0);
+    return 0;
+}
@@ -0,0 +1,386 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "affinity.h"
+#include "fiber.h"
+
+#define FIBER_OUTPUT_SIZE 16384
+
+/* How long an idle thread with sleeping tasks waits before looking at the clock again. */
+#define FIBER_IDLE_NANOS 50000
+
+typedef struct FiberThread FiberThread;
+
+typedef struct {
+    ucontext_t context;
+    char *stack;
+    FiberThread *thread;
+    WorkerContext worker;
+    int maxSec;
+    int maxNano;
+    /* Set by whoever first makes the task runnable; cleared when its thread picks it up. */
+    _Atomic int queued;
+    /* From launch until runWorker returns; a slot is only reused once this drops. */
+    _Atomic int busy;
+    int finished;
+} Fiber;
+
+/* A task waiting for the clock to reach wakeAt. */
+typedef struct {
+    long long wakeAt;
+    int slot;
+} Sleeper;
+
+struct FiberThread {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    /* Circular run queue of slots; queued keeps each slot on it at most once. */
+    int *runQueue;
+    int runHead;
+    int runCount;
+    int runCapacity;
+    /* Only touched by the thread itself. */
+    ucontext_t scheduler;
+    Fiber *current;
+    Sleeper *sleepers;
+    int sleeperCount;
+    int sleeperCapacity;
+    char output[FIBER_OUTPUT_SIZE];
+    int outputLength;
+};
+
+static SharedSegment *segment;
+static Fiber *fibers;
+static int capacity;
+static FiberThread *threads;
+static int threadCount;
+static _Atomic int stopping;
+
+static __thread FiberThread *self;
+
+static void flushOutput(FiberThread *thread) {
+    int written = 0;
+
+    while (written < thread->outputLength) {
+        ssize_t n = write(STDOUT_FILENO, thread->output + written, thread->outputLength - written);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        written += n;
+    }
+    thread->outputLength = 0;
+}
+
+static void makeRunnable(int slot) {
+    Fiber *fiber = &fibers[slot];
+    FiberThread *thread = fiber->thread;
+
+    if (atomic_exchange(&fiber->queued, 1)) {
+        return;
+    }
+    pthread_mutex_lock(&thread->lock);
+    thread->runQueue[(thread->runHead + thread->runCount) % thread->runCapacity] = slot;
+    thread->runCount++;
+    pthread_cond_signal(&thread->ready);
+    pthread_mutex_unlock(&thread->lock);
+}
+
+static int takeRunnable(FiberThread *thread) {
+    int slot = -1;
+
+    pthread_mutex_lock(&thread->lock);
+    if (thread->runCount > 0) {
+        slot = thread->runQueue[thread->runHead];
+        thread->runHead = (thread->runHead + 1) % thread->runCapacity;
+        thread->runCount--;
+    }
+    pthread_mutex_unlock(&thread->lock);
+    return slot;
+}
+
+/* Sleep until a task is made runnable, or for a moment if some are waiting on the clock. */
+static void idle(FiberThread *thread) {
+    pthread_mutex_lock(&thread->lock);
+    if (thread->runCount == 0 && !atomic_load(&stopping)) {
+        if (thread->sleeperCount > 0) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += FIBER_IDLE_NANOS;
+            if (until.tv_nsec >= NANOS_PER_SEC) {
+                until.tv_sec++;
+                until.tv_nsec -= NANOS_PER_SEC;
+            }
+            pthread_cond_timedwait(&thread->ready, &thread->lock, &until);
+        } else {
+            pthread_cond_wait(&thread->ready, &thread->lock);
+        }
+    }
+    pthread_mutex_unlock(&thread->lock);
+}
+
+/* Min-heap on wakeAt. */
+static int addSleeper(FiberThread *thread, long long wakeAt, int slot) {
+    if (thread->sleeperCount == thread->sleeperCapacity) {
+        int grown = thread->sleeperCapacity > 0 ? 2 * thread->sleeperCapacity : 64;
+        Sleeper *sleepers = realloc(thread->sleepers, grown * sizeof(Sleeper));
+        if (!sleepers) {
+            return -1;
+        }
+        thread->sleepers = sleepers;
+        thread->sleeperCapacity = grown;
+    }
+    int i = thread->sleeperCount++;
+    while (i > 0 && thread->sleepers[(i - 1) / 2].wakeAt > wakeAt) {
+        thread->sleepers[i] = thread->sleepers[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    thread->sleepers[i].wakeAt = wakeAt;
+    thread->sleepers[i].slot = slot;
+    return 0;
+}
+
+static void wakeSleepers(FiberThread *thread) {
+    long long now = clockRead(&segment->clock);
+
+    while (thread->sleeperCount > 0 && thread->sleepers[0].wakeAt <= now) {
+        int slot = thread->sleepers[0].slot;
+        Sleeper last = thread->sleepers[--thread->sleeperCount];
+        int i = 0;
+        for (;;) {
+            int child = 2 * i + 1;
+            if (child >= thread->sleeperCount) {
+                break;
+            }
+            if (child + 1 < thread->sleeperCount && thread->sleepers[child + 1].wakeAt < thread->sleepers[child].wakeAt) {
+                child++;
+            }
+            if (thread->sleepers[child].wakeAt >= last.wakeAt) {
+                break;
+            }
+            thread->sleepers[i] = thread->sleepers[child];
+            i = child;
+        }
+        thread->sleepers[i] = last;
+        makeRunnable(slot);
+    }
+}
+
+/* Give the thread back to its scheduler until someone makes this task runnable again. */
+static void park(void) {
+    swapcontext(&self->current->context, &self->scheduler);
+}
+
+static void fiberMain(void) {
+    Fiber *fiber = self->current;
+
+    runWorker(&fiber->worker, fiber->maxSec, fiber->maxNano);
+    fiber->finished = 1;
+}
+
+static void *schedulerMain(void *arg) {
+    FiberThread *thread = arg;
+
+    self = thread;
+    while (!atomic_load(&stopping)) {
+        wakeSleepers(thread);
+        int slot = takeRunnable(thread);
+        if (slot == -1) {
+            flushOutput(thread);
+            idle(thread);
+            continue;
+        }
+        Fiber *fiber = &fibers[slot];
+        atomic_store(&fiber->queued, 0);
+        if (!atomic_load(&fiber->busy)) {
+            continue;
+        }
+        thread->current = fiber;
+        swapcontext(&thread->scheduler, &fiber->context);
+        thread->current = NULL;
+        if (fiber->finished) {
+            atomic_store(&fiber->busy, 0);
+        }
+    }
+    flushOutput(thread);
+    return NULL;
+}
+
+static void fiberWaitForTick(WorkerContext *worker, struct msgbuf *msg) {
+    while (!ringPop(&worker->segment->slots[worker->slot].toWorker, msg)) {
+        park();
+    }
+}
+
+static void fiberAnswerTick(WorkerContext *worker, struct msgbuf *msg) {
+    msg->mtype = worker->pid;
+    ringSend(&worker->segment->slots[worker->slot].toOss, msg);
+    bellRing(worker->segment);
+}
+
+static long long fiberWaitUntil(WorkerContext *worker, long long first, long long second) {
+    long long until = first < second ? first : second;
+    long long now;
+
+    while ((now = clockRead(&worker->segment->clock)) < until) {
+        if (addSleeper(self, until, worker->slot) == -1) {
+            return clockWaitUntil(&worker->segment->clock, first, second);
+        }
+        park();
+    }
+    return now;
+}
+
+static void fiberOutput(WorkerContext *worker, const char *line, int length) {
+    if (!line) {
+        return;
+    }
+    if (self->outputLength + length > FIBER_OUTPUT_SIZE) {
+        flushOutput(self);
+    }
+    memcpy(self->output + self->outputLength, line, length);
+    self->outputLength += length;
+}
+
+static const WorkerOps fiberOps = {fiberWaitForTick, fiberAnswerTick, fiberWaitUntil, fiberOutput};
+
+static void fiberClose(void) {
+    if (!threads) {
+        return;
+    }
+    atomic_store(&stopping, 1);
+    for (int i = 0; i < threadCount; i++) {
+        pthread_mutex_lock(&threads[i].lock);
+        pthread_cond_broadcast(&threads[i].ready);
+        pthread_mutex_unlock(&threads[i].lock);
+    }
+    for (int i = 0; i < threadCount; i++) {
+        pthread_join(threads[i].thread, NULL);
+        free(threads[i].runQueue);
+        free(threads[i].sleepers);
+    }
+    for (int i = 0; i < capacity; i++) {
+        if (fibers[i].stack) {
+            munmap(fibers[i].stack, FIBER_STACK_SIZE);
+        }
+    }
+    free(threads);
+    free(fibers);
+    threads = NULL;
+    fibers = NULL;
+}
+
+static int fiberOpen(SharedSegment *seg, int cap) {
+    sigset_t all, old;
+
+    segment = seg;
+    capacity = cap;
+    threadCount = onlineCpus();
+    if (threadCount > capacity) {
+        threadCount = capacity;
+    }
+    fibers = calloc(capacity, sizeof(Fiber));
+    threads = calloc(threadCount, sizeof(FiberThread));
+    if (!fibers || !threads) {
+        free(fibers);
+        free(threads);
+        threads = NULL;
+        errno = ENOMEM;
+        return -1;
+    }
+    for (int i = 0; i < capacity; i++) {
+        fibers[i].thread = &threads[i % threadCount];
+    }
+
+    /* Signals stay with oss's main thread. */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    for (int i = 0; i < threadCount; i++) {
+        FiberThread *thread = &threads[i];
+        pthread_mutex_init(&thread->lock, NULL);
+        pthread_cond_init(&thread->ready, NULL);
+        thread->runCapacity = (capacity + threadCount - 1) / threadCount;
+        thread->runQueue = malloc(thread->runCapacity * sizeof(int));
+        if (!thread->runQueue || (errno = pthread_create(&thread->thread, NULL, schedulerMain, thread)) != 0) {
+            if (!thread->runQueue) {
+                errno = ENOMEM;
+            }
+            int error = errno;
+            threadCount = i;
+            pthread_sigmask(SIG_SETMASK, &old, NULL);
+            free(thread->runQueue);
+            fiberClose();
+            errno = error;
+            return -1;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return 0;
+}
+
+/* The slot's last task may still be printing after its final reply; let it finish first. */
+static void fiberPrepare(int slot) {
+    while (atomic_load(&fibers[slot].busy)) {
+        sched_yield();
+    }
+    ringReset(&segment->slots[slot].toWorker);
+    ringReset(&segment->slots[slot].toOss);
+}
+
+static int fiberSend(int slot, const struct msgbuf *msg) {
+    ringSend(&segment->slots[slot].toWorker, msg);
+    makeRunnable(slot);
+    return 0;
+}
+
+static int fiberPoll(int slot, pid_t pid, struct msgbuf *msg) {
+    return ringPop(&segment->slots[slot].toOss, msg);
+}
+
+static unsigned int fiberArm(void) {
+    return bellRead(segment);
+}
+
+static void fiberWaitReply(unsigned int token, long timeoutNanos) {
+    bellWait(segment, token, timeoutNanos);
+}
+
+void fiberLaunch(const WorkerContext *worker, int maxSec, int maxNano) {
+    Fiber *fiber = &fibers[worker->slot];
+
+    if (!fiber->stack) {
+        fiber->stack = mmap(NULL, FIBER_STACK_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (fiber->stack == MAP_FAILED) {
+            fiber->stack = NULL;
+            perror("oss: mmap fiber stack");
+            exit(EXIT_FAILURE);
+        }
+    }
+    fiber->worker = *worker;
+    fiber->worker.ops = &fiberOps;
+    fiber->maxSec = maxSec;
+    fiber->maxNano = maxNano;
+    fiber->finished = 0;
+    getcontext(&fiber->context);
+    fiber->context.uc_stack.ss_sp = fiber->stack;
+    fiber->context.uc_stack.ss_size = FIBER_STACK_SIZE;
+    fiber->context.uc_link = &fiber->thread->scheduler;
+    makecontext(&fiber->context, fiberMain, 0);
+    atomic_store(&fiber->busy, 1);
+    makeRunnable(worker->slot);
+}
+
+/* Workers never attach: the tasks live in oss and use fiberOps directly. */
+const Transport fiberTransport = {"fiber", TRANSPORT_FIBER, fiberOpen, fiberClose, fiberPrepare, NULL, fiberSend,
+                                  fiberPoll, NULL, fiberArm, fiberWaitReply, NULL, NULL, NULL};
@@ -0,0 +1,40 @@
+#ifndef FIBER_H
+#define FIBER_H
+
+#include "transport.h"
+#include "workerloop.h"
+
+/*
+ * In-process worker engine (oss -e fiber). Instead of forking a worker per
+ * slot, oss runs runWorker() as a user-space task on its own small stack,
+ * and a pool of scheduler threads, one per CPU, switches between the tasks
+ * with swapcontext. A task that finds no tick waiting, or has to sit out a
+ * grant, parks and gives its thread to the next runnable one, so thousands
+ * of workers cost a few kilobytes each rather than a process.
+ *
+ * oss talks to the tasks through fiberTransport: the same per-slot rings
+ * and reply bell as the futex backend, except that a send makes the task
+ * runnable on its thread instead of waking a process.
+ */
+extern const Transport fiberTransport;
+
+/*
+ * Synthetic pids for tasks start here, above any real pid (see shared.h), so
+ * they can never be mistaken for a process in logs, traces or oss's pid map.
+ * That breaks the pid < 2^22 rule the SysV mtypes rely on, which is safe only
+ * because task messages never go over SysV (oss refuses -e fiber with -m) and
+ * a task pid is never a statsKey (that is always oss's own pid).
+ */
+#define FIBER_PID_BASE (1 << 22)
+_Static_assert(FIBER_PID_BASE >= TO_WORKER_OFFSET, "task pids must lie above every real pid");
+
+/* Bytes of stack per task. runWorker needs little beyond one output line. */
+#define FIBER_STACK_SIZE (32 * 1024)
+
+/*
+ * Start a task running runWorker() for worker's slot, after transport
+ * prepare() for that slot. worker->ops is filled in here.
+ */
+void fiberLaunch(const WorkerContext *worker, int maxSec, int maxNano);
+
+#endif
@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+
+/* Turn a binary oss log (oss -L binary) back into oss.log text on stdout. */
+int main(int argc, char *argv[]) {
+    char magic[sizeof(LOG_MAGIC)];
+    LogRecord rec;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <binaryLog>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror("fopen failed");
+        return EXIT_FAILURE;
+    }
+
+    if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) || memcmp(magic, LOG_MAGIC, sizeof(magic)) != 0) {
+        fprintf(stderr, "Error: %s is not a binary oss log.\n", argv[1]);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+
+    while (fread(&rec, sizeof(rec), 1, in) == 1) {
+        logFormat(stdout, &rec);
+    }
+
+    fclose(in);
+    return EXIT_SUCCESS;
+}
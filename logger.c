@@ -0,0 +1,151 @@
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "logger.h"
+#include "shared.h"
+
+static FILE *logFile;
+static int logMode = LOG_TEXT;
+
+/*
+ * Binary records go through a bounded multi-producer/single-consumer ring.
+ * Any dispatcher thread claims a cell by bumping tail, copies its 24 bytes
+ * in and publishes the cell through its sequence number; the writer thread
+ * collects published cells in order and does the stdio work off the hot
+ * path. A cell's seq is pos + 1 once record pos is in it, and pos +
+ * LOG_RING_SIZE once the writer has taken it and it is free for the next lap.
+ */
+typedef struct {
+    _Atomic unsigned int seq;
+    LogRecord rec;
+} LogCell;
+
+static LogCell *ring;
+static LogRecord *batch;
+static _Atomic unsigned int ringTail;
+static unsigned int ringHead;
+static atomic_int closing;
+static pthread_t writer;
+
+static void *writerMain(void *arg) {
+    struct timespec nap = {0, 1000000};
+
+    while (1) {
+        unsigned int count = 0;
+        while (count < LOG_RING_SIZE) {
+            LogCell *cell = &ring[ringHead & (LOG_RING_SIZE - 1)];
+            if (atomic_load_explicit(&cell->seq, memory_order_acquire) != ringHead + 1) {
+                break;
+            }
+            batch[count++] = cell->rec;
+            atomic_store_explicit(&cell->seq, ringHead + LOG_RING_SIZE, memory_order_release);
+            ringHead++;
+        }
+        if (count > 0) {
+            fwrite(batch, sizeof(LogRecord), count, logFile);
+            continue;
+        }
+        /* Producers are done once closing is set, so an empty ring then stays empty. */
+        if (atomic_load(&closing) && atomic_load(&ringTail) == ringHead) {
+            break;
+        }
+        nanosleep(&nap, NULL);
+    }
+    return NULL;
+}
+
+int logOpen(const char *path, int mode) {
+    logMode = mode;
+    logFile = fopen(path, mode == LOG_BINARY ? "wb" : "w");
+    if (!logFile) {
+        return -1;
+    }
+    if (mode == LOG_TEXT) {
+        return 0;
+    }
+
+    ring = calloc(LOG_RING_SIZE, sizeof(LogCell));
+    batch = calloc(LOG_RING_SIZE, sizeof(LogRecord));
+    if (!ring || !batch) {
+        free(ring);
+        free(batch);
+        fclose(logFile);
+        logFile = NULL;
+        return -1;
+    }
+    for (unsigned int i = 0; i < LOG_RING_SIZE; i++) {
+        atomic_init(&ring[i].seq, i);
+    }
+    fwrite(LOG_MAGIC, 1, sizeof(LOG_MAGIC), logFile);
+
+    /* Keep every signal on the main thread; oss reads SIGCHLD through a signalfd. */
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int err = pthread_create(&writer, NULL, writerMain, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err != 0) {
+        fclose(logFile);
+        logFile = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void logEvent(int type, int slot, pid_t pid, long long clock) {
+    LogRecord rec = {type, slot, pid, 0, clock};
+
+    if (logMode == LOG_TEXT) {
+        logFormat(logFile, &rec);
+        return;
+    }
+
+    unsigned int pos = atomic_fetch_add_explicit(&ringTail, 1, memory_order_relaxed);
+    LogCell *cell = &ring[pos & (LOG_RING_SIZE - 1)];
+    while (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos) {
+        sched_yield();
+    }
+    cell->rec = rec;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+}
+
+void logClose(void) {
+    if (!logFile) {
+        return;
+    }
+    if (logMode == LOG_BINARY) {
+        atomic_store(&closing, 1);
+        pthread_join(writer, NULL);
+        free(ring);
+        free(batch);
+        ring = NULL;
+        batch = NULL;
+    }
+    fclose(logFile);
+    logFile = NULL;
+}
+
+void logFormat(FILE *out, const LogRecord *rec) {
+    int sec = clockSeconds(rec->clock);
+    int nano = clockNanoseconds(rec->clock);
+
+    switch (rec->type) {
+        case LOG_SEND:
+            fprintf(out, "OSS: Sending message to worker %d PID %d at time %d:%d\n", rec->slot, rec->pid, sec, nano);
+            break;
+        case LOG_RECEIVE:
+            fprintf(out, "OSS: Receiving message from worker %d PID %d at time %d:%d\n", rec->slot, rec->pid, sec, nano);
+            break;
+        case LOG_TERMINATE:
+            fprintf(out, "OSS: Worker %d PID %d is planning to terminate.\n", rec->slot, rec->pid);
+            break;
+        case LOG_LOST:
+            fprintf(out, "OSS: Worker %d PID %d exited without replying.\n", rec->slot, rec->pid);
+            break;
+    }
+}
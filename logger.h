@@ -0,0 +1,41 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#define LOG_SEND 0
+#define LOG_RECEIVE 1
+#define LOG_TERMINATE 2
+#define LOG_LOST 3
+
+#define LOG_TEXT 0
+#define LOG_BINARY 1
+
+#define LOG_MAGIC "OSSLOG1"
+#define LOG_RING_SIZE (1 << 16)
+
+/* One oss.log line in binary form. clock is the SharedClock value in nanoseconds. */
+typedef struct {
+    int type;
+    int slot;
+    int pid;
+    int reserved;
+    long long clock;
+} LogRecord;
+
+/*
+ * Open the oss log. Text mode formats every line inline as before; binary
+ * mode appends LogRecords to an in-memory ring that a background thread
+ * drains to the file, and logdump turns them back into the same text.
+ * logEvent may be called from several threads at once.
+ * Returns -1 with errno set if the file can't be opened.
+ */
+int logOpen(const char *path, int mode);
+void logEvent(int type, int slot, pid_t pid, long long clock);
+void logClose(void);
+
+/* Print a record exactly as text mode would have. */
+void logFormat(FILE *out, const LogRecord *rec);
+
+#endif
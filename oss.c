@@ -6,146 +6,1988 @@
 #include <sys/msg.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
 
-#define SHM_KEY 12345
-#define MSG_KEY 54321
-#define MSG_SIZE sizeof(struct msgbuf) - sizeof(long)
-#define MAX_CHILDREN 20
+#include "affinity.h"
+#include "fiber.h"
+#include "logger.h"
+#include "shared.h"
+#include "stats.h"
+#include "trace.h"
+#include "transport.h"
+#include "wheel.h"
 
-typedef struct {
-    int seconds;
-    int nanoseconds;
-} SharedClock;
+#define DISPATCH_SERIAL 0
+#define DISPATCH_GATHER 1
+#define DISPATCH_BROADCAST 2
 
-struct msgbuf {
-    long mtype;
-    int mtext;
-};
+#define ENGINE_PROCESS 0
+#define ENGINE_FIBER 1
+
+#define CLOCK_TICK 0
+#define CLOCK_EVENT 1
+
+#define TICK_NANOS 1000000
+#define QUANTUM_MAX INT_MAX
+
+#define POLICY_RR 0
+#define POLICY_SRT 1
+#define POLICY_PRIORITY 2
+
+#define PRIORITY_CLASSES 4
 
 typedef struct {
     int occupied;
     pid_t pid;
     int startSec;
     int startNano;
-    int messagesSent;
+    /* Ticks the worker reports having run, summed over its replies. */
+    int iterations;
+    int awaitingReply;
+    int granted;
+    int grantUnsent;
+    long long grantEnd;
+    PayloadHandle payload;
+    int launchId;
+    long long deadline;
+    long long launchedAt;
+    long long sentAt;
+    int replied;
+    int activeIndex;
+    int priority;
+    int queued;
+    long long readySince;
+    /* dispatchSeq when it was queued; ready wait is counted in dispatch rounds. */
+    unsigned int readySeq;
+    unsigned int dealtSeq;
+    atomic_int exited;
 } ProcessTableEntry;
 
-ProcessTableEntry processTable[MAX_CHILDREN];
+/* A worker waiting for its next grant, ordered by rank, then key, then launch. */
+typedef struct {
+    int rank;
+    long long key;
+    int slot;
+    int launchId;
+} ReadyEntry;
+
+/*
+ * A scheduling policy (-S) only decides where a ready worker goes in the
+ * ready queue: lower rank first, then lower key.
+ */
+typedef struct {
+    const char *name;
+    void (*order)(int slot, int *rank, long long *key);
+} SchedPolicy;
+
+/*
+ * One dispatcher's share of the occupied slots for a tick. With -T the slots
+ * are dealt out to one shard per dispatcher thread; otherwise the main thread
+ * runs a single shard holding all of them. Shards never touch the free list
+ * or the pid hash: slots that finish or die are recorded here and released
+ * by the main thread once every shard is done.
+ */
+typedef struct {
+    int *slots;
+    int count;
+    int pending;
+    int *finished;
+    int finishedCount;
+    int *lost;
+    int lostCount;
+    int cpu;
+    pthread_t thread;
+} Shard;
+
+/*
+ * The process table has one entry per simultaneous worker. Free entries sit
+ * on a stack so a launch claims one in O(1); occupied entries are also kept
+ * densely in activeSlots so dispatch only walks workers that exist; and
+ * pids map back to slots through an open-addressing hash.
+ */
+ProcessTableEntry *processTable;
+int tableSize;
+int *freeSlots;
+int freeCount;
+int *activeSlots;
+int activeCount;
+pid_t *hashPids;
+int *hashSlots;
+int hashMask;
+
+SharedSegment *segment;
 SharedClock *simClock;
-int shmid, msqid;
-FILE *logFile;
+int shmid;
+
+/* Payload arena for -P: every tick message carries payloadBytes bytes in it. */
+PayloadArena *arena;
+int arenaShmid = -1;
+unsigned int payloadBytes;
+const Transport *transport;
+
+int dispatch = DISPATCH_SERIAL;
+unsigned int broadcastEpoch;
+
+/*
+ * Ticks a worker may run per message (-q). A grant made at tick T runs to
+ * grantEnd = T + (quantum - 1) ticks, or to the worker's deadline if that
+ * comes first; the worker only answers once the clock reaches it. With a
+ * quantum of 1 that is the usual message and reply every tick; with
+ * QUANTUM_MAX (-q max) a worker is sent one message for its whole life and
+ * left alone until its timer says it is done.
+ */
+int quantum = 1;
+int clockMode = CLOCK_TICK;
+int usePool = 0;
+/* -e fiber runs workers as tasks inside oss; they get pids from FIBER_PID_BASE up. */
+int engine = ENGINE_PROCESS;
+pid_t nextFiberPid = FIBER_PID_BASE;
+pid_t *poolPids;
+int logMode = LOG_TEXT;
+/* -R: directory for this run's trace files, or NULL. */
+const char *traceDir;
+int outputEvery = OUTPUT_ALL;
+
+int childrenRunning;
+
+/*
+ * Workers that have answered their last grant wait in the ready queue, a
+ * min-heap ordered by the scheduling policy. Each tick oss grants the front
+ * of the queue until runLimit workers hold a grant (-k; 0 is no limit). Like
+ * the deadline heap, entries of workers that have since left are dropped
+ * when they reach the top.
+ */
+const SchedPolicy *policy;
+int runLimit = 0;
+ReadyEntry *readyQueue;
+int readyCount;
+int readyCapacity;
+int readyBacklog;
+int grantedWorkers;
+
+/*
+ * Per-run scheduling metrics. Turnaround is in simulated nanoseconds; ready
+ * waits are in dispatch rounds, counted from the round a worker answered in,
+ * so a worker granted straight away has still waited one round.
+ */
+int finishedWorkers;
+long long iterationsTotal;
+long long turnaroundTotal;
+long long turnaroundMax;
+long long readyWaitTotal;
+int grantsMade;
+
+/*
+ * Run parameters: how many workers to launch in all, how many at once, the
+ * longest a worker may run in simulated seconds, and the wall-clock pause
+ * between tick-mode ticks in milliseconds.
+ */
+int numProcs = 5;
+int simul = 2;
+int timeLimit = 5;
+int interval = 100;
+/* -w: wall-clock seconds before the run is abandoned as timed out, 0 for no limit. */
+int wallLimit = 60;
+/* -g: seed for worker run times and priorities; 1 is what rand() uses unseeded. */
+unsigned int seed = 1;
+/* -l: the log file, oss.log or oss.bin by default. -r: where to write the run summary, or NULL. */
+const char *logPath;
+const char *summaryPath;
+const Transport *requested;
+const char *progName;
+
+/*
+ * Names under which every option can be given in a config file (-f) or as
+ * -o name=value. Flags take yes or no.
+ */
+typedef struct {
+    const char *name;
+    int opt;
+} Setting;
+
+const Setting settings[] = {
+    {"procs", 'n'},      {"simul", 's'},     {"time-limit", 't'}, {"interval", 'i'}, {"transport", 'm'},
+    {"engine", 'e'},     {"dispatch", 'd'},  {"clock", 'c'},      {"pool", 'p'},     {"log-format", 'L'},
+    {"log-file", 'l'},   {"summary", 'r'},   {"trace-dir", 'R'},  {"verbosity", 'v'}, {"threads", 'T'},
+    {"quantum", 'q'},    {"payload", 'P'},   {"policy", 'S'},     {"run-limit", 'k'}, {"placement", 'a'},
+    {"cpus", 'C'},       {"wall-limit", 'w'}, {"seed", 'g'},
+};
+
+/* CPU placement of oss and its worker processes (-a, over the CPUs in -C); see affinity.h. */
+int placementPolicy = PLACE_NONE;
+const char *placementCpus;
+Placement placement;
+int lastOssCpu = -1;
+
+/* Dispatcher threads (-T); 0 dispatches on the main thread. */
+int dispatcherThreads = 0;
+Shard *shards;
+int shardCount;
+pthread_barrier_t tickStart;
+atomic_int shardsDone;
+atomic_int stopping;
+/* Set by a dispatcher thread that hit an error; the main thread ends the run after the tick. */
+atomic_int dispatchFailed;
+pthread_t mainThread;
+int shardsDoneFd = -1;
+
+/* SIGCHLD is blocked and read from here so children are reaped without stalling dispatch. */
+int sigchldFd = -1;
+int liveChildren;
+
+/* Live per-slot counters for ossstat; see stats.h. */
+StatsSegment *stats;
+int statsShmid = -1;
+
+/* Wall time from a logical launch to that child's first reply. */
+_Atomic long long launchLatencyTotal;
+atomic_int launchLatencyCount;
 
+/*
+ * Timers for the ends of grants, plus worker deadlines and -q regrants for
+ * the event-driven clock. A tick only has to look at the workers whose
+ * timers go off, not at every worker holding a grant. A worker that exits
+ * is queued in exitedSlots by the reaper for the next dispatch.
+ */
+TimingWheel timers;
+int *exitedSlots;
+int exitedCount;
+
+/* Bumped every dispatch, so a slot dealt for two reasons is only dealt once. */
+unsigned int dispatchSeq;
+
+/* Wall time the run started, for the summary's wall_seconds. */
+long long runStart;
+
+/* Tear everything down and exit. 0 is a normal end; errors and signals exit with EXIT_FAILURE. */
 void cleanup(int signum) {
-    shmdt(simClock);
+    /* Ring workers never see the queue disappear, so make sure none outlive us. */
+    for (int i = 0; engine == ENGINE_PROCESS && i < activeCount; i++) {
+        kill(processTable[activeSlots[i]].pid, SIGTERM);
+    }
+    for (int i = 0; poolPids && i < tableSize; i++) {
+        if (poolPids[i] > 0) {
+            kill(poolPids[i], SIGTERM);
+        }
+    }
+    transport->close();
+    if (statsShmid != -1) {
+        atomic_store(&stats->running, 0);
+        shmdt(stats);
+        shmctl(statsShmid, IPC_RMID, NULL);
+    }
+    shmdt(segment);
     shmctl(shmid, IPC_RMID, NULL);
-    msgctl(msqid, IPC_RMID, NULL);
-    if (logFile) {
-        fclose(logFile);
+    if (arenaShmid != -1) {
+        shmdt(arena);
+        shmctl(arenaShmid, IPC_RMID, NULL);
+    }
+    logClose();
+    traceClose();
+    exit(signum == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+void incrementClock(void) {
+    clockWrite(simClock, clockRead(simClock) + TICK_NANOS);
+}
+
+long long wallNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NANOS_PER_SEC + ts.tv_nsec;
+}
+
+long long clockNanos(void) {
+    return clockRead(simClock);
+}
+
+void setClock(long long nanos) {
+    clockWrite(simClock, nanos);
+}
+
+/* Run-wide figures for ossstat, once a tick. */
+void publishStats(void) {
+    int cpu = currentCpu();
+    if (cpu != lastOssCpu) {
+        if (lastOssCpu >= 0) {
+            statsAdd(&stats->ossMigrations, 1);
+        }
+        lastOssCpu = cpu;
+    }
+    atomic_store_explicit(&stats->simNanos, clockNanos(), memory_order_relaxed);
+    atomic_store_explicit(&stats->workers, childrenRunning, memory_order_relaxed);
+    atomic_store_explicit(&stats->finished, finishedWorkers, memory_order_relaxed);
+}
+
+/* oss's per-slot counters summed over the table. */
+typedef struct {
+    unsigned long long messages;
+    unsigned long long replies;
+    unsigned long long roundTrip;
+    unsigned long long roundTripMax;
+    unsigned long long sendBlocked;
+    unsigned long long receiveBlocked;
+    unsigned long long workerMigrations;
+} StatsTotals;
+
+void sumStats(int slots, StatsTotals *totals) {
+    memset(totals, 0, sizeof(*totals));
+    for (int i = 0; i < slots; i++) {
+        OssSlotStats *slotStats = &stats->slots[i].oss;
+        totals->messages += statsRead(&slotStats->messages);
+        totals->replies += statsRead(&slotStats->replies);
+        totals->roundTrip += statsRead(&slotStats->roundTripTotal);
+        totals->sendBlocked += statsRead(&slotStats->sendBlocked);
+        totals->receiveBlocked += statsRead(&slotStats->receiveBlocked);
+        totals->workerMigrations += statsRead(&stats->slots[i].worker.migrations);
+        if (statsRead(&slotStats->roundTripMax) > totals->roundTripMax) {
+            totals->roundTripMax = statsRead(&slotStats->roundTripMax);
+        }
+    }
+}
+
+void reportStats(int slots) {
+    StatsTotals totals;
+
+    sumStats(slots, &totals);
+    if (totals.replies > 0) {
+        fprintf(stderr, "OSS: %llu messages, round trip mean %.1f us max %.1f us, "
+                        "%.1f ms in send, %.1f ms waiting for replies\n",
+                totals.messages, totals.roundTrip / 1000.0 / totals.replies, totals.roundTripMax / 1000.0,
+                totals.sendBlocked / 1e6, totals.receiveBlocked / 1e6);
+    }
+    if (placementPolicy != PLACE_NONE) {
+        char cpus[256];
+        formatCpus(placement.workerCpus, placement.workerCount, cpus, sizeof(cpus));
+        fprintf(stderr, "OSS: %s placement, oss on cpu %d, workers on %s\n", placementName(placementPolicy),
+                placement.ossCpu, cpus);
+    }
+    fprintf(stderr, "OSS: %llu oss and %llu worker cpu migrations\n", statsRead(&stats->ossMigrations),
+            totals.workerMigrations);
+}
+
+/*
+ * The run's results on one line of name=value pairs for -r, which is what
+ * sweep collects. Throughput is workers finished per simulated second,
+ * turnaround is in simulated seconds and the rest is wall time.
+ */
+/* status is ok for a run that finished, timeout for one cut off by -w. */
+void writeSummary(const char *path, long long wallElapsed, const char *status) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return;
+    }
+    StatsTotals totals;
+    sumStats(simul, &totals);
+    double simSeconds = (double)clockNanos() / NANOS_PER_SEC;
+    double wallSeconds = (double)wallElapsed / NANOS_PER_SEC;
+    fprintf(file, "status=%s seed=%u finished=%d sim_seconds=%.3f wall_seconds=%.3f throughput=%.3f wall_throughput=%.3f "
+                  "turnaround_mean=%.4f turnaround_max=%.4f ready_wait=%.3f grants=%d iterations=%lld messages=%llu "
+                  "replies=%llu "
+                  "rtt_mean_us=%.2f rtt_max_us=%.1f send_ms=%.1f wait_ms=%.1f launch_latency_us=%.1f "
+                  "placement=%s oss_migrations=%llu worker_migrations=%llu\n",
+            status, seed, finishedWorkers, simSeconds, wallSeconds, simSeconds > 0 ? finishedWorkers / simSeconds : 0.0,
+            wallSeconds > 0 ? finishedWorkers / wallSeconds : 0.0,
+            finishedWorkers > 0 ? (double)turnaroundTotal / finishedWorkers / NANOS_PER_SEC : 0.0,
+            (double)turnaroundMax / NANOS_PER_SEC,
+            grantsMade > 0 ? (double)readyWaitTotal / grantsMade : 0.0, grantsMade, iterationsTotal,
+            totals.messages, totals.replies, totals.replies > 0 ? totals.roundTrip / 1000.0 / totals.replies : 0.0,
+            totals.roundTripMax / 1000.0, totals.sendBlocked / 1e6, totals.receiveBlocked / 1e6,
+            launchLatencyCount > 0 ? launchLatencyTotal / 1000.0 / launchLatencyCount : 0.0,
+            placementName(placementPolicy), statsRead(&stats->ossMigrations), totals.workerMigrations);
+    fclose(file);
+}
+
+/*
+ * SIGALRM (the run went over -w) and SIGINT only note the signal: stdio and
+ * the logger aren't safe to use from a handler. Waits return early with
+ * EINTR, dispatch loops give up the tick, and the main loop stops the run.
+ */
+atomic_int stopSignal;
+
+void stopRequested(int signum) {
+    atomic_store(&stopSignal, signum);
+}
+
+/* A timed-out run still writes its summary, marked as such, and exits nonzero. */
+void stopIfSignalled(void) {
+    int signum = atomic_load(&stopSignal);
+    if (signum == 0) {
+        return;
+    }
+    if (signum == SIGALRM) {
+        fprintf(stderr, "OSS: wall-clock limit of %d seconds reached, stopping.\n", wallLimit);
+        if (summaryPath) {
+            writeSummary(summaryPath, wallNanos() - runStart, "timeout");
+        }
+    }
+    cleanup(signum);
+}
+
+/* Dispatch loops stop waiting for replies once the run is being stopped. */
+int tickAbandoned(void) {
+    return atomic_load(&dispatchFailed) || atomic_load(&stopSignal);
+}
+
+int timerLive(int slot, int launchId) {
+    return processTable[slot].occupied && processTable[slot].launchId == launchId;
+}
+
+void armTimer(long long time, int slot) {
+    if (wheelAdd(&timers, time / TICK_NANOS, slot, processTable[slot].launchId) == -1) {
+        perror("wheelAdd failed");
+        cleanup(1);
+    }
+}
+
+/* Earliest upcoming deadline or grant end of a worker that is still running. */
+long long nextDeadline(void) {
+    long long tick = wheelNext(&timers);
+    return tick < 0 ? -1 : tick * TICK_NANOS;
+}
+
+/* Ready in the order they became ready: plain round robin. */
+void orderRoundRobin(int slot, int *rank, long long *key) {
+    *rank = 0;
+    *key = processTable[slot].readySince;
+}
+
+/* Shortest remaining time first; every worker's remaining time is its deadline minus the same now. */
+void orderShortestRemaining(int slot, int *rank, long long *key) {
+    *rank = 0;
+    *key = processTable[slot].deadline;
+}
+
+/* Strict priority classes, round robin within a class. */
+void orderPriority(int slot, int *rank, long long *key) {
+    *rank = processTable[slot].priority;
+    *key = processTable[slot].readySince;
+}
+
+const SchedPolicy policies[] = {
+    {"rr", orderRoundRobin},
+    {"srt", orderShortestRemaining},
+    {"priority", orderPriority},
+};
+
+int readyBefore(const ReadyEntry *a, const ReadyEntry *b) {
+    if (a->rank != b->rank) {
+        return a->rank < b->rank;
+    }
+    if (a->key != b->key) {
+        return a->key < b->key;
+    }
+    return a->launchId < b->launchId;
+}
+
+void swapReady(int a, int b) {
+    ReadyEntry tmp = readyQueue[a];
+    readyQueue[a] = readyQueue[b];
+    readyQueue[b] = tmp;
+}
+
+void pushReady(int slot) {
+    if (processTable[slot].queued) {
+        return;
+    }
+    if (readyCount == readyCapacity) {
+        readyCapacity *= 2;
+        readyQueue = realloc(readyQueue, readyCapacity * sizeof(ReadyEntry));
+        if (!readyQueue) {
+            perror("realloc failed");
+            cleanup(1);
+        }
+    }
+    processTable[slot].queued = 1;
+    processTable[slot].readySince = clockNanos();
+    processTable[slot].readySeq = dispatchSeq;
+    int i = readyCount++;
+    policy->order(slot, &readyQueue[i].rank, &readyQueue[i].key);
+    readyQueue[i].slot = slot;
+    readyQueue[i].launchId = processTable[slot].launchId;
+    while (i > 0 && readyBefore(&readyQueue[i], &readyQueue[(i - 1) / 2])) {
+        swapReady(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+void popReady(void) {
+    int i = 0;
+    readyQueue[0] = readyQueue[--readyCount];
+    while (1) {
+        int first = i;
+        int left = 2 * i + 1;
+        int right = 2 * i + 2;
+        if (left < readyCount && readyBefore(&readyQueue[left], &readyQueue[first])) {
+            first = left;
+        }
+        if (right < readyCount && readyBefore(&readyQueue[right], &readyQueue[first])) {
+            first = right;
+        }
+        if (first == i) {
+            break;
+        }
+        swapReady(i, first);
+        i = first;
+    }
+}
+
+/* The worker the policy would grant next, or -1 if none is waiting. */
+int nextReady(void) {
+    while (readyCount > 0) {
+        ReadyEntry *top = &readyQueue[0];
+        ProcessTableEntry *entry = &processTable[top->slot];
+        if (entry->occupied && entry->launchId == top->launchId && !entry->granted) {
+            return top->slot;
+        }
+        popReady();
+    }
+    return -1;
+}
+
+/*
+ * The first tick at which a worker launched at startNanos with the given
+ * lifetime sees the clock at or past its termination time. Workers are only
+ * messaged after the clock has advanced, so that is never earlier than one
+ * tick after launch.
+ */
+long long terminationTick(long long startNanos, int maxSec, int maxNano) {
+    long long term = startNanos + maxSec * NANOS_PER_SEC + maxNano;
+    long long tick = (term + TICK_NANOS - 1) / TICK_NANOS * TICK_NANOS;
+    if (tick < startNanos + TICK_NANOS) {
+        tick = startNanos + TICK_NANOS;
+    }
+    return tick;
+}
+
+void *allocOrDie(size_t count, size_t size) {
+    void *p = calloc(count, size);
+    if (!p) {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+void initProcessTable(int size) {
+    int hashSize = 1;
+    while (hashSize < 2 * size) {
+        hashSize <<= 1;
+    }
+
+    tableSize = size;
+    processTable = allocOrDie(size, sizeof(ProcessTableEntry));
+    freeSlots = allocOrDie(size, sizeof(int));
+    activeSlots = allocOrDie(size, sizeof(int));
+    poolPids = allocOrDie(size, sizeof(pid_t));
+    exitedSlots = allocOrDie(2 * size, sizeof(int));
+    if (wheelInit(&timers, 2 * size, timerLive) == -1) {
+        perror("wheelInit failed");
+        exit(EXIT_FAILURE);
+    }
+    readyCapacity = 2 * size;
+    readyQueue = allocOrDie(readyCapacity, sizeof(ReadyEntry));
+    hashPids = allocOrDie(hashSize, sizeof(pid_t));
+    hashSlots = allocOrDie(hashSize, sizeof(int));
+    hashMask = hashSize - 1;
+
+    /* Pushed in reverse so the first launches get slots 0, 1, 2, ... */
+    for (int i = size - 1; i >= 0; i--) {
+        freeSlots[freeCount++] = i;
+    }
+}
+
+int allocSlot(void) {
+    int slot = freeSlots[--freeCount];
+    processTable[slot].occupied = 1;
+    atomic_store(&processTable[slot].exited, 0);
+    processTable[slot].activeIndex = activeCount;
+    activeSlots[activeCount++] = slot;
+    return slot;
+}
+
+/* Swap the last active slot into the hole so the active list stays dense. */
+void releaseSlot(int slot) {
+    int last = activeSlots[--activeCount];
+    activeSlots[processTable[slot].activeIndex] = last;
+    processTable[last].activeIndex = processTable[slot].activeIndex;
+    processTable[slot].occupied = 0;
+    freeSlots[freeCount++] = slot;
+}
+
+int pidHash(pid_t pid) {
+    return (int)((unsigned int)pid * 2654435761u) & hashMask;
+}
+
+void mapPid(pid_t pid, int slot) {
+    int i = pidHash(pid);
+    while (hashPids[i] != 0 && hashPids[i] != pid) {
+        i = (i + 1) & hashMask;
+    }
+    hashPids[i] = pid;
+    hashSlots[i] = slot;
+}
+
+/* Linear-probing delete: pull later entries of the same run back into the hole. */
+void unmapPid(pid_t pid) {
+    int i = pidHash(pid);
+    while (hashPids[i] != pid) {
+        if (hashPids[i] == 0) {
+            return;
+        }
+        i = (i + 1) & hashMask;
+    }
+    hashPids[i] = 0;
+    for (int j = (i + 1) & hashMask; hashPids[j] != 0; j = (j + 1) & hashMask) {
+        int home = pidHash(hashPids[j]);
+        if (((j - home) & hashMask) >= ((j - i) & hashMask)) {
+            hashPids[i] = hashPids[j];
+            hashSlots[i] = hashSlots[j];
+            hashPids[j] = 0;
+            i = j;
+        }
+    }
+}
+
+int findSlotByPid(pid_t pid) {
+    for (int i = pidHash(pid); hashPids[i] != 0; i = (i + 1) & hashMask) {
+        if (hashPids[i] == pid) {
+            return hashSlots[i];
+        }
+    }
+    return -1;
+}
+
+/* A logical child is done with its slot. Pool workers keep their pid mapping. */
+void freeSlot(int slot) {
+    if (!usePool) {
+        unmapPid(processTable[slot].pid);
+    }
+    releaseSlot(slot);
+}
+
+/*
+ * A send or receive failed while dispatching. The main thread can end the
+ * run there and then; a dispatcher thread can't tear down what the others
+ * are using, so it flags the error, abandons the tick, and leaves the exit
+ * to the main thread. A send cut short by -w or SIGINT is no error: the tick
+ * is being abandoned anyway.
+ */
+void dispatchError(const char *what) {
+    if (errno == EINTR && atomic_load(&stopSignal)) {
+        return;
+    }
+    perror(what);
+    if (pthread_equal(pthread_self(), mainThread)) {
+        cleanup(1);
+    }
+    atomic_store(&dispatchFailed, 1);
+}
+
+void sendToWorker(int slot, struct msgbuf *msg) {
+    if (transport->send(slot, msg) == -1) {
+        dispatchError("send failed");
+    }
+}
+
+/* A worker exited before saying it was done: free its slot and any payload it was still holding. */
+void workerLost(int slot) {
+    logEvent(LOG_LOST, slot, processTable[slot].pid, clockNanos());
+    traceEvent(TRACE_LOST, slot, processTable[slot].pid, 0, clockNanos());
+    if (processTable[slot].payload.length > 0) {
+        arenaRelease(arena, &processTable[slot].payload);
+    }
+    freeSlot(slot);
+    childrenRunning--;
+}
+
+/*
+ * Collect every child the kernel has finished with. Workers that said they
+ * were done give up their slot at the end of the tick, so this only matters
+ * for workers that died unexpectedly, or that answered the end of a grant
+ * and exited before oss got round to reading it. The slot is only flagged
+ * here: the next dispatch reads whatever reply the worker left behind and
+ * gives up on it otherwise.
+ */
+void reapChildren(void) {
+    struct signalfd_siginfo info;
+    pid_t pid;
+
+    while (read(sigchldFd, &info, sizeof(info)) == sizeof(info)) {
+    }
+    while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+        liveChildren--;
+        int slot = findSlotByPid(pid);
+        traceEvent(TRACE_REAP, slot, pid, 0, clockNanos());
+        if (slot < 0) {
+            continue;
+        }
+        if (usePool && poolPids[slot] == pid) {
+            poolPids[slot] = 0;
+            unmapPid(pid);
+        }
+        if (processTable[slot].occupied && processTable[slot].pid == pid) {
+            atomic_store(&processTable[slot].exited, 1);
+            exitedSlots[exitedCount++] = slot;
+        }
+    }
+}
+
+/* Sleep until a child changes state or timeoutMs passes, then reap. */
+void pollChildren(int timeoutMs) {
+    struct pollfd pfd = {sigchldFd, POLLIN, 0};
+    poll(&pfd, 1, timeoutMs);
+    reapChildren();
+}
+
+/*
+ * Like ringBackoff, but the slow path also notices workers that have died.
+ * Dispatcher threads leave reaping to the main thread and just nap. When the
+ * transport can sleep until a reply arrives (and always with broadcast
+ * dispatch, whose workers ring the reply bell) the nap is that wait instead,
+ * so a reply wakes us at once. token comes from armWait(), called before the
+ * caller last looked.
+ */
+unsigned int armWait(void) {
+    if (dispatch == DISPATCH_BROADCAST) {
+        return bellRead(segment);
+    }
+    return transport->arm ? transport->arm() : 0;
+}
+
+void waitBackoff(int *attempts, unsigned int token) {
+    struct timespec nap = {0, 50000};
+
+    if (*attempts < RING_SPINS) {
+        (*attempts)++;
+    } else if (dispatch == DISPATCH_BROADCAST || transport->wait) {
+        if (dispatch == DISPATCH_BROADCAST) {
+            bellWait(segment, token, 1000000);
+        } else {
+            transport->wait(token, 1000000);
+        }
+        if (dispatcherThreads == 0) {
+            reapChildren();
+        }
+    } else if (*attempts < RING_SPINS + RING_YIELDS) {
+        (*attempts)++;
+        sched_yield();
+    } else if (dispatcherThreads == 0) {
+        pollChildren(1);
+    } else {
+        nanosleep(&nap, NULL);
+    }
+}
+
+/* Stop waiting on a slot whose worker died; the main thread releases it after the tick. */
+void giveUp(Shard *shard, int slot) {
+    processTable[slot].awaitingReply = 0;
+    shard->pending--;
+    shard->lost[shard->lostCount++] = slot;
+}
+
+/*
+ * Try to take the slot's reply without blocking. exited is read first: a
+ * worker replies before it exits, so if it was already gone and there is
+ * still nothing to read, it is never going to answer.
+ */
+int pollReply(Shard *shard, int slot, struct msgbuf *msg) {
+    int gone = atomic_load(&processTable[slot].exited);
+    int got = transport->poll(slot, processTable[slot].pid, msg);
+
+    if (got == 1) {
+        return 1;
+    } else if (got == -1) {
+        dispatchError("receive failed");
+    }
+    if (gone) {
+        giveUp(shard, slot);
+    }
+    return 0;
+}
+
+/* Wait for the slot's worker to answer. Returns 0 if it died first. */
+int receiveFromWorker(Shard *shard, int slot, struct msgbuf *msg) {
+    int attempts = 0;
+    long long start = wallNanos();
+
+    while (processTable[slot].awaitingReply && !tickAbandoned()) {
+        unsigned int token = armWait();
+        if (pollReply(shard, slot, msg)) {
+            statsAdd(&stats->slots[slot].oss.receiveBlocked, wallNanos() - start);
+            return 1;
+        }
+        waitBackoff(&attempts, token);
+    }
+    return 0;
+}
+
+/*
+ * Wait for a reply from any worker in the shard we are still waiting on and
+ * return its slot, or -1 once nobody is left to wait for. A lone dispatcher
+ * can take whichever SysV reply comes first; with several dispatchers on the
+ * one queue each has to ask for its own workers' pids.
+ */
+int awaitAnyReply(Shard *shard, struct msgbuf *msg) {
+    int attempts = 0;
+
+    while (shard->pending > 0 && !tickAbandoned()) {
+        unsigned int token = armWait();
+        if (transport->pollAny && dispatcherThreads == 0) {
+            int got = transport->pollAny(msg, 0);
+            if (got == 1) {
+                int slot = findSlotByPid(msg->mtype);
+                if (slot >= 0 && processTable[slot].awaitingReply) {
+                    return slot;
+                }
+                continue;
+            } else if (got == -1) {
+                dispatchError("receive failed");
+            }
+            for (int i = 0; i < shard->count; i++) {
+                int slot = shard->slots[i];
+                if (processTable[slot].awaitingReply && atomic_load(&processTable[slot].exited) &&
+                    pollReply(shard, slot, msg)) {
+                    return slot;
+                }
+            }
+        } else {
+            for (int i = 0; i < shard->count; i++) {
+                int slot = shard->slots[i];
+                if (processTable[slot].awaitingReply && pollReply(shard, slot, msg)) {
+                    return slot;
+                }
+            }
+        }
+        waitBackoff(&attempts, token);
+    }
+    return -1;
+}
+
+/* The time spent waiting goes to the slot whose reply ends it. */
+int receiveFromAnyWorker(Shard *shard, struct msgbuf *msg) {
+    long long start = wallNanos();
+    int slot = awaitAnyReply(shard, msg);
+
+    if (slot >= 0) {
+        statsAdd(&stats->slots[slot].oss.receiveBlocked, wallNanos() - start);
+    }
+    return slot;
+}
+
+/*
+ * Write the tick's payload straight into an arena block; only the handle goes
+ * in the message. Each worker releases its block before answering, so there
+ * are always blocks to spare.
+ */
+int attachPayload(int slot, struct msgbuf *msg, long long now) {
+    if (arenaAlloc(arena, payloadBytes, &msg->payload) == -1) {
+        errno = ENOBUFS;
+        dispatchError("payload arena exhausted");
+        return -1;
+    }
+    unsigned char *data = arenaData(arena, &msg->payload);
+    memset(data, slot & 0xff, payloadBytes);
+    memcpy(data, &now, payloadBytes < sizeof(now) ? payloadBytes : sizeof(now));
+    processTable[slot].payload = msg->payload;
+    return 0;
+}
+
+/* Send the slot's new grant; the worker reads where it ends from its SlotInfo. */
+void sendTick(int slot) {
+    long long now = clockNanos();
+    struct msgbuf msg = {0};
+    msg.mtype = toWorkerType(processTable[slot].pid);
+    msg.mtext = MSG_TICK;
+    msg.count = quantum;
+    if (payloadBytes > 0 && attachPayload(slot, &msg, now) == -1) {
+        return;
+    }
+    segment->slots[slot].info.grantStart = now;
+    segment->slots[slot].info.grantEnd = processTable[slot].grantEnd;
+    processTable[slot].grantUnsent = 0;
+    long long sendStart = wallNanos();
+    traceEvent(TRACE_SEND, slot, processTable[slot].pid, 0, now);
+    sendToWorker(slot, &msg);
+    processTable[slot].sentAt = wallNanos();
+    statsAdd(&stats->slots[slot].oss.messages, 1);
+    statsAdd(&stats->slots[slot].oss.sendBlocked, processTable[slot].sentAt - sendStart);
+    logEvent(LOG_SEND, slot, processTable[slot].pid, now);
+}
+
+/* The slot's grant runs out this tick, so its worker is about to answer. */
+int replyDue(int slot) {
+    return clockNanos() >= processTable[slot].grantEnd;
+}
+
+void expectReply(Shard *shard, int slot) {
+    processTable[slot].awaitingReply = 1;
+    shard->pending++;
+}
+
+/*
+ * Log a worker's reply and note whether it is done. The worker touches
+ * neither its slot nor the slot's stats after the final reply, so the main
+ * thread can hand the slot out again as soon as the tick ends; the process
+ * itself is reaped whenever its SIGCHLD shows up.
+ */
+void handleReply(Shard *shard, int slot, struct msgbuf *msg) {
+    long long now = clockNanos();
+    traceEvent(TRACE_RECEIVE, slot, processTable[slot].pid, msg->mtext, now);
+    logEvent(LOG_RECEIVE, slot, processTable[slot].pid, now);
+    processTable[slot].awaitingReply = 0;
+    shard->pending--;
+
+    OssSlotStats *slotStats = &stats->slots[slot].oss;
+    long long wallNow = wallNanos();
+    statsAdd(&slotStats->replies, 1);
+    statsAdd(&slotStats->roundTripTotal, wallNow - processTable[slot].sentAt);
+    statsMax(&slotStats->roundTripMax, wallNow - processTable[slot].sentAt);
+    if (!processTable[slot].replied) {
+        long long latency = wallNow - processTable[slot].launchedAt;
+        processTable[slot].replied = 1;
+        atomic_fetch_add(&launchLatencyTotal, latency);
+        atomic_fetch_add(&launchLatencyCount, 1);
+        statsAdd(&slotStats->firstReplies, 1);
+        statsAdd(&slotStats->firstReplyTotal, latency);
+        statsMax(&slotStats->firstReplyMax, latency);
+    }
+    processTable[slot].iterations += msg->count;
+    statsAdd(&slotStats->iterations, msg->count);
+    if (msg->mtext == 0) {
+        logEvent(LOG_TERMINATE, slot, processTable[slot].pid, now);
+        traceEvent(TRACE_TERMINATE, slot, processTable[slot].pid, 0, now);
+        shard->finished[shard->finishedCount++] = slot;
+        return;
+    }
+    processTable[slot].granted = 0;
+}
+
+/* Message each worker in turn and wait for its answer before moving on. */
+void dispatchSerial(Shard *shard) {
+    struct msgbuf msg;
+
+    for (int i = 0; i < shard->count; i++) {
+        int slot = shard->slots[i];
+        int gone = atomic_load(&processTable[slot].exited);
+        if (!gone && processTable[slot].grantUnsent) {
+            sendTick(slot);
+        }
+        if (gone || replyDue(slot)) {
+            expectReply(shard, slot);
+            if (receiveFromWorker(shard, slot, &msg)) {
+                handleReply(shard, slot, &msg);
+            }
+        }
+    }
+}
+
+/*
+ * Message every worker first and then collect the answers in whatever order
+ * they come back, so the tick costs the slowest worker rather than the sum.
+ */
+void dispatchGather(Shard *shard) {
+    struct msgbuf msg;
+    int slot;
+
+    for (int i = 0; i < shard->count; i++) {
+        slot = shard->slots[i];
+        int gone = atomic_load(&processTable[slot].exited);
+        if (!gone && processTable[slot].grantUnsent) {
+            sendTick(slot);
+        }
+        if (gone || replyDue(slot)) {
+            expectReply(shard, slot);
+        }
+    }
+    while ((slot = receiveFromAnyWorker(shard, &msg)) >= 0) {
+        handleReply(shard, slot, &msg);
+    }
+}
+
+/*
+ * The tick went out to everyone as one epoch bump; log it per worker as the
+ * other modes do and then scan the shard's slots until every worker has
+ * posted its answer for this epoch or died.
+ */
+void dispatchBroadcast(Shard *shard) {
+    long long now = clockNanos();
+    /* One broadcast answer always covers exactly one tick. */
+    struct msgbuf msg = {0};
+    msg.count = 1;
+    int attempts = 0;
+
+    /* Workers may already have answered and exited; the scan below sorts them out. */
+    for (int i = 0; i < shard->count; i++) {
+        int slot = shard->slots[i];
+        processTable[slot].awaitingReply = 1;
+        shard->pending++;
+        logEvent(LOG_SEND, slot, processTable[slot].pid, now);
+    }
+
+    while (shard->pending > 0 && !tickAbandoned()) {
+        unsigned int bell = bellRead(segment);
+        int answered = 0;
+        for (int i = 0; i < shard->count; i++) {
+            int slot = shard->slots[i];
+            if (!processTable[slot].awaitingReply) {
+                continue;
+            }
+            TickAnswer *answer = &segment->slots[slot].answer;
+            int gone = atomic_load(&processTable[slot].exited);
+            if (atomic_load_explicit(&answer->epoch, memory_order_acquire) == broadcastEpoch) {
+                msg.mtext = answer->answer;
+                handleReply(shard, slot, &msg);
+                answered = 1;
+            } else if (gone) {
+                giveUp(shard, slot);
+            }
+        }
+        if (!answered) {
+            waitBackoff(&attempts, bell);
+        }
+    }
+}
+
+void runShard(Shard *shard) {
+    if (dispatch == DISPATCH_BROADCAST) {
+        dispatchBroadcast(shard);
+    } else if (dispatch == DISPATCH_GATHER) {
+        dispatchGather(shard);
+    } else {
+        dispatchSerial(shard);
+    }
+}
+
+void *dispatcherMain(void *arg) {
+    Shard *shard = arg;
+
+    if (pinThread(shard->cpu) == -1) {
+        perror("pinThread failed");
+    }
+
+    while (1) {
+        pthread_barrier_wait(&tickStart);
+        if (atomic_load(&stopping)) {
+            break;
+        }
+        runShard(shard);
+        if (atomic_fetch_add(&shardsDone, 1) + 1 == shardCount) {
+            uint64_t one = 1;
+            write(shardsDoneFd, &one, sizeof(one));
+        }
+    }
+    return NULL;
+}
+
+void initShards(void) {
+    shardCount = dispatcherThreads > 0 ? dispatcherThreads : 1;
+    shards = allocOrDie(shardCount, sizeof(Shard));
+    for (int i = 0; i < shardCount; i++) {
+        shards[i].slots = allocOrDie(tableSize, sizeof(int));
+        shards[i].finished = allocOrDie(tableSize, sizeof(int));
+        shards[i].lost = allocOrDie(tableSize, sizeof(int));
+        /* Only CPUs we may run on, and past oss's own when it is pinned. */
+        int first = placement.policy == PLACE_NONE ? 0 : 1;
+        shards[i].cpu = placement.cpus[(first + i) % placement.cpuCount];
+    }
+    if (dispatcherThreads == 0) {
+        return;
+    }
+
+    shardsDoneFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (shardsDoneFd == -1) {
+        perror("eventfd failed");
+        exit(EXIT_FAILURE);
+    }
+    pthread_barrier_init(&tickStart, NULL, shardCount + 1);
+
+    /* Dispatchers inherit a full signal mask so SIGCHLD and friends stay on the main thread. */
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (int i = 0; i < shardCount; i++) {
+        if (pthread_create(&shards[i].thread, NULL, dispatcherMain, &shards[i]) != 0) {
+            perror("pthread_create failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+void stopShards(void) {
+    if (dispatcherThreads == 0) {
+        return;
+    }
+    atomic_store(&stopping, 1);
+    pthread_barrier_wait(&tickStart);
+    for (int i = 0; i < shardCount; i++) {
+        pthread_join(shards[i].thread, NULL);
+    }
+}
+
+/*
+ * Give the slot a new grant if its last one was answered. A grant that runs
+ * past this tick sets a timer for its end, when the worker will answer.
+ */
+void grantTicks(int slot) {
+    ProcessTableEntry *entry = &processTable[slot];
+    long long now = clockNanos();
+    long long end = now + (long long)(quantum - 1) * TICK_NANOS;
+
+    if (entry->granted) {
+        return;
+    }
+    entry->granted = 1;
+    entry->grantUnsent = 1;
+    entry->grantEnd = end < entry->deadline ? end : entry->deadline;
+    grantedWorkers++;
+    if (entry->grantEnd > now) {
+        armTimer(entry->grantEnd, slot);
+    }
+}
+
+void dealSlot(int slot) {
+    if (processTable[slot].dealtSeq == dispatchSeq) {
+        return;
+    }
+    processTable[slot].dealtSeq = dispatchSeq;
+    Shard *shard = &shards[slot % shardCount];
+    shard->slots[shard->count++] = slot;
+}
+
+/* A deadline, grant end or regrant came up; only a grant end needs the worker woken and dealt. */
+void timerFired(int slot, int launchId) {
+    if (processTable[slot].granted && replyDue(slot)) {
+        grantRing(&segment->slots[slot]);
+        dealSlot(slot);
+    }
+}
+
+/*
+ * Deal the slots that owe a reply this tick out to the shards, followed by
+ * as many ready workers as the run limit allows in the policy's order. Run
+ * the shards (on this thread, or on the dispatcher threads while this one
+ * keeps reaping), then release every slot whose worker finished or died
+ * during the tick and queue the ones that answered for another grant.
+ */
+void dispatchTick(void) {
+    dispatchSeq++;
+    for (int i = 0; i < shardCount; i++) {
+        shards[i].count = 0;
+        shards[i].pending = 0;
+        shards[i].finishedCount = 0;
+        shards[i].lostCount = 0;
+    }
+    wheelAdvance(&timers, clockNanos() / TICK_NANOS, timerFired);
+    if (dispatch == DISPATCH_BROADCAST) {
+        for (int i = 0; i < activeCount; i++) {
+            dealSlot(activeSlots[i]);
+        }
+    } else {
+        int slot;
+
+        /* A worker that died mid-grant or while waiting in the ready queue still has to be given up on. */
+        for (int i = 0; i < exitedCount; i++) {
+            slot = exitedSlots[i];
+            if (processTable[slot].occupied && atomic_load(&processTable[slot].exited)) {
+                grantTicks(slot);
+                dealSlot(slot);
+            }
+        }
+        while ((runLimit == 0 || grantedWorkers < runLimit) && (slot = nextReady()) != -1) {
+            popReady();
+            processTable[slot].queued = 0;
+            /*
+             * Rounds, not simulated time: with -c event the clock jumps
+             * between events, and that gap is not time spent queued.
+             */
+            readyWaitTotal += dispatchSeq - processTable[slot].readySeq;
+            grantsMade++;
+            grantTicks(slot);
+            dealSlot(slot);
+        }
+        readyBacklog = nextReady() != -1;
+    }
+    exitedCount = 0;
+
+    if (traceFile) {
+        int dealt = 0;
+        for (int i = 0; i < shardCount; i++) {
+            dealt += shards[i].count;
+        }
+        traceEvent(TRACE_TICK, -1, 0, dealt, clockNanos());
+    }
+    if (dispatch == DISPATCH_BROADCAST) {
+        /* Workers start on the epoch the moment it is published, so it counts as sent from here. */
+        long long sentAt = wallNanos();
+        for (int i = 0; i < activeCount; i++) {
+            int slot = activeSlots[i];
+            processTable[slot].sentAt = sentAt;
+            statsAdd(&stats->slots[slot].oss.messages, 1);
+            traceEvent(TRACE_SEND, slot, processTable[slot].pid, 0, clockNanos());
+        }
+        broadcastEpoch = tickPublish(segment);
+    }
+    if (dispatcherThreads == 0) {
+        runShard(&shards[0]);
+        stopIfSignalled();
+    } else {
+        struct pollfd pfds[2] = {{sigchldFd, POLLIN, 0}, {shardsDoneFd, POLLIN, 0}};
+        uint64_t done;
+
+        atomic_store(&shardsDone, 0);
+        pthread_barrier_wait(&tickStart);
+        while (atomic_load(&shardsDone) < shardCount) {
+            poll(pfds, 2, -1);
+            reapChildren();
+        }
+        read(shardsDoneFd, &done, sizeof(done));
+        if (atomic_load(&dispatchFailed)) {
+            fprintf(stderr, "OSS: a dispatcher thread failed, stopping.\n");
+            cleanup(1);
+        }
+        stopIfSignalled();
+    }
+    traceEvent(TRACE_TICK_DONE, -1, 0, 0, clockNanos());
+
+    for (int i = 0; i < shardCount; i++) {
+        for (int j = 0; j < shards[i].finishedCount; j++) {
+            int slot = shards[i].finished[j];
+            long long turnaround = clockNanos() - (processTable[slot].startSec * NANOS_PER_SEC +
+                                                   processTable[slot].startNano);
+            finishedWorkers++;
+            iterationsTotal += processTable[slot].iterations;
+            turnaroundTotal += turnaround;
+            if (turnaround > turnaroundMax) {
+                turnaroundMax = turnaround;
+            }
+            freeSlot(slot);
+            childrenRunning--;
+        }
+        for (int j = 0; j < shards[i].lostCount; j++) {
+            workerLost(shards[i].lost[j]);
+        }
+        /*
+         * Workers that answered wait for their next grant. In event mode with
+         * -q that grant is also an event on the very next tick, so no ticks
+         * go uncounted.
+         */
+        for (int j = 0; dispatch != DISPATCH_BROADCAST && j < shards[i].count; j++) {
+            int slot = shards[i].slots[j];
+            if (processTable[slot].occupied && processTable[slot].granted) {
+                continue;
+            }
+            grantedWorkers--;
+            if (!processTable[slot].occupied) {
+                continue;
+            }
+            pushReady(slot);
+            if (clockMode == CLOCK_EVENT && quantum > 1) {
+                armTimer(clockNanos() + TICK_NANOS, slot);
+            }
+        }
+    }
+}
+
+pid_t spawnWorker(int slot, char *args[]) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGCHLD);
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        if (transport->inherit) {
+            transport->inherit(slot);
+        }
+        if (placeWorker(&placement, slot) == -1) {
+            perror("placeWorker failed");
+        }
+        execv("./worker", args);
+        perror("execv failed");
+        exit(EXIT_FAILURE);
+    } else if (pid < 0) {
+        perror("fork failed");
+        cleanup(1);
+    }
+    liveChildren++;
+    return pid;
+}
+
+void startPoolWorker(int slot) {
+    char slotStr[10];
+    char *args[] = {"./worker", "-p", slotStr, NULL};
+    snprintf(slotStr, 10, "%d", slot);
+    transport->prepare(slot);
+    poolPids[slot] = spawnWorker(slot, args);
+    mapPid(poolPids[slot], slot);
+}
+
+/* Start one long-lived worker per slot that logical children will be handed to. */
+void startPool(int size) {
+    for (int i = 0; i < size; i++) {
+        startPoolWorker(i);
     }
-    exit(0);
 }
 
-void incrementClock(int childrenRunning) {
-    simClock->nanoseconds += 1000000;
-    if (simClock->nanoseconds >= 1000000000) {
-        simClock->seconds++;
-        simClock->nanoseconds -= 1000000000;
+void stopPool(void) {
+    struct msgbuf msg;
+    for (int i = 0; i < tableSize; i++) {
+        if (poolPids[i] > 0) {
+            msg.mtype = toWorkerType(poolPids[i]);
+            msg.mtext = MSG_EXIT;
+            /* Best effort: a pool worker that already died can't be told. */
+            transport->send(i, &msg);
+        }
     }
 }
 
+/* Hand a logical child to the slot's pool worker, start a fiber for it, or fork a new worker. */
+pid_t launchWorker(int slot, int maxSec, int maxNano) {
+    segment->slots[slot].info.maxSec = maxSec;
+    segment->slots[slot].info.maxNano = maxNano;
+    segment->slots[slot].info.startEpoch = atomic_load(&segment->tickEpoch);
+
+    if (engine == ENGINE_FIBER) {
+        WorkerContext worker = {NULL, segment, arena, slot, nextFiberPid++, getpid(), 0, &stats->slots[slot]};
+        transport->prepare(slot);
+        fiberLaunch(&worker, maxSec, maxNano);
+        mapPid(worker.pid, slot);
+        return worker.pid;
+    }
+
+    if (usePool) {
+        struct msgbuf msg;
+        if (poolPids[slot] == 0) {
+            startPoolWorker(slot);
+        }
+        msg.mtype = toWorkerType(poolPids[slot]);
+        msg.mtext = MSG_ASSIGN;
+        sendToWorker(slot, &msg);
+        return poolPids[slot];
+    }
+
+    char maxSecStr[10], maxNanoStr[10], slotStr[10];
+    char *args[] = {"./worker", maxSecStr, maxNanoStr, slotStr, NULL};
+    snprintf(maxSecStr, 10, "%d", maxSec);
+    snprintf(maxNanoStr, 10, "%d", maxNano);
+    snprintf(slotStr, 10, "%d", slot);
+    transport->prepare(slot);
+    pid_t pid = spawnWorker(slot, args);
+    mapPid(pid, slot);
+    return pid;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-f config] [-o name=value] [-n procs] [-s simul] [-t seconds] [-i ms]\n"
+                    "          [-l logfile] [-r summary] [-a none|oss|spread|sibling] [-C cpus] [-m %s]\n"
+                    "          [-e process|fiber] [-d serial|gather|broadcast] [-c tick|event] [-p]\n"
+                    "          [-L text|binary] [-R dir] [-v all|edges|N] [-T threads] [-q ticks|max]\n"
+                    "          [-P bytes] [-S rr|srt|priority] [-k workers] [-w seconds] [-g seed]\n", prog, transportNames());
+    fprintf(stderr, "  -f  read settings from a file of name = value lines\n");
+    fprintf(stderr, "  -o  one setting: procs, simul, time-limit, interval, log-file, summary,\n");
+    fprintf(stderr, "      transport, engine, dispatch, clock, pool (yes|no), log-format,\n");
+    fprintf(stderr, "      trace-dir, verbosity, threads, quantum, payload, policy, run-limit,\n");
+    fprintf(stderr, "      placement, cpus, wall-limit or seed\n");
+    fprintf(stderr, "  -n  workers to launch in all (default 5)\n");
+    fprintf(stderr, "  -s  workers running at once (default 2)\n");
+    fprintf(stderr, "  -t  longest a worker runs, in simulated seconds (default 5)\n");
+    fprintf(stderr, "  -i  wall-clock pause between ticks in tick mode, in ms (default 100)\n");
+    fprintf(stderr, "  -w  give up after this many wall-clock seconds, 0 for never (default 60)\n");
+    fprintf(stderr, "  -g  seed for worker run times and priorities (default 1)\n");
+    fprintf(stderr, "  -l  log file (default oss.log, or oss.bin with -L binary)\n");
+    fprintf(stderr, "  -r  write the run's results to this file as one line of name=value\n");
+    fprintf(stderr, "  -a  CPU placement: leave it to the kernel, pin oss to one CPU, also pin\n");
+    fprintf(stderr, "      workers round robin over the other CPUs, or put every worker on oss's\n");
+    fprintf(stderr, "      hyperthread sibling (default none)\n");
+    fprintf(stderr, "  -C  CPUs to place on, e.g. 0-3,6; oss takes the first (default all allowed)\n");
+    fprintf(stderr, "  -m  message transport between oss and workers (default sysv): SysV queue,\n");
+    fprintf(stderr, "      polled shared-memory ring, ring with futex wakeups, POSIX queues,\n");
+    fprintf(stderr, "      Unix seqpacket sockets, or futex rings out and one shared reply queue back\n");
+    fprintf(stderr, "  -e  run each worker as a process, or as a user-space task on oss's own\n");
+    fprintf(stderr, "      scheduler threads; fiber picks its own transport (default process)\n");
+    fprintf(stderr, "  -d  serial waits for each worker in turn, gather messages all of them\n");
+    fprintf(stderr, "      before collecting replies, broadcast wakes all of them with one futex\n");
+    fprintf(stderr, "      call and reads their answers from shared memory (default serial)\n");
+    fprintf(stderr, "  -c  tick advances the clock 1ms at a time, event jumps it straight to the\n");
+    fprintf(stderr, "      next launch or termination (default tick)\n");
+    fprintf(stderr, "  -p  pre-fork simul workers and reuse them for every launch\n");
+    fprintf(stderr, "  -L  text writes oss.log directly, binary writes oss.bin from a background\n");
+    fprintf(stderr, "      thread; decode it with logdump (default text)\n");
+    fprintf(stderr, "  -R  record a binary event trace from oss and every worker into dir;\n");
+    fprintf(stderr, "      read it with traceview\n");
+    fprintf(stderr, "  -v  worker progress lines: every iteration, only start and terminate,\n");
+    fprintf(stderr, "      or every N iterations (default all)\n");
+    fprintf(stderr, "  -T  shard the process table across this many pinned dispatcher threads\n");
+    fprintf(stderr, "      (default 0: dispatch on the main thread)\n");
+    fprintf(stderr, "  -q  grant each worker this many ticks per message; it answers when they\n");
+    fprintf(stderr, "      run out or it terminates (default 1); max sends one message that lasts\n");
+    fprintf(stderr, "      until the worker's deadline\n");
+    fprintf(stderr, "  -P  attach a payload of this many bytes to every tick, passed by handle\n");
+    fprintf(stderr, "      through a shared-memory arena (default none)\n");
+    fprintf(stderr, "  -S  order in which waiting workers are granted ticks: round robin, shortest\n");
+    fprintf(stderr, "      remaining time, or %d random priority classes (default rr)\n", PRIORITY_CLASSES);
+    fprintf(stderr, "  -k  let at most this many workers hold a grant at once (default all)\n");
+}
+
+/* Apply one option, from the command line or a config file. Exits on a bad value. */
+void setOption(int opt, const char *arg) {
+    switch (opt) {
+        case 'n':
+            numProcs = atoi(arg);
+            if (numProcs <= 0) {
+                fprintf(stderr, "Error: the number of workers must be a positive integer.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 's':
+            simul = atoi(arg);
+            if (simul <= 0) {
+                fprintf(stderr, "Error: simultaneous workers must be a positive integer.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 't':
+            timeLimit = atoi(arg);
+            if (timeLimit <= 0) {
+                fprintf(stderr, "Error: the time limit must be a positive number of seconds.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'w':
+            wallLimit = atoi(arg);
+            if (wallLimit < 0 || (wallLimit == 0 && strcmp(arg, "0") != 0)) {
+                fprintf(stderr, "Error: the wall-clock limit must be a non-negative number of seconds.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'g': {
+            char *end;
+            seed = strtoul(arg, &end, 10);
+            if (*arg == '\0' || *end != '\0') {
+                fprintf(stderr, "Error: the seed must be a non-negative integer.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        }
+        case 'i':
+            interval = atoi(arg);
+            if (interval < 0 || (interval == 0 && strcmp(arg, "0") != 0)) {
+                fprintf(stderr, "Error: the interval must be a non-negative number of milliseconds.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'l':
+            logPath = arg;
+            break;
+        case 'r':
+            summaryPath = arg;
+            break;
+        case 'a':
+            placementPolicy = placementByName(arg);
+            if (placementPolicy < 0) {
+                fprintf(stderr, "Unknown placement '%s'\n", arg);
+                usage(progName);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'C':
+            placementCpus = arg;
+            break;
+        case 'm':
+            requested = transportByName(arg);
+            if (!requested) {
+                fprintf(stderr, "Unknown transport '%s'\n", arg);
+                usage(progName);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'e':
+            if (strcmp(arg, "process") == 0) {
+                engine = ENGINE_PROCESS;
+            } else if (strcmp(arg, "fiber") == 0) {
+                engine = ENGINE_FIBER;
+            } else {
+                fprintf(stderr, "Unknown worker engine '%s'\n", arg);
+                usage(progName);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'd':
+            if (strcmp(arg, "serial") == 0) {
+                dispatch = DISPATCH_SERIAL;
+            } else if (strcmp(arg, "gather") == 0) {
+                dispatch = DISPATCH_GATHER;
+            } else if (strcmp(arg, "broadcast") == 0) {
+                dispatch = DISPATCH_BROADCAST;
+            } else {
+                fprintf(stderr, "Unknown dispatch mode '%s'\n", arg);
+                usage(progName);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'c':
+            if (strcmp(arg, "tick") == 0) {
+                clockMode = CLOCK_TICK;
+            } else if (strcmp(arg, "event") == 0) {
+                clockMode = CLOCK_EVENT;
+            } else {
+                fprintf(stderr, "Unknown clock mode '%s'\n", arg);
+                usage(progName);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'p':
+            usePool = !arg || strcmp(arg, "yes") == 0;
+            if (arg && !usePool && strcmp(arg, "no") != 0) {
+                fprintf(stderr, "Error: pool must be yes or no.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'L':
+            if (strcmp(arg, "text") == 0) {
+                logMode = LOG_TEXT;
+            } else if (strcmp(arg, "binary") == 0) {
+                logMode = LOG_BINARY;
+            } else {
+                fprintf(stderr, "Unknown log format '%s'\n", arg);
+                usage(progName);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'R':
+            traceDir = arg;
+            if (strlen(traceDir) >= sizeof(segment->traceDir)) {
+                fprintf(stderr, "Error: trace directory name is too long.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'v':
+            if (strcmp(arg, "all") == 0) {
+                outputEvery = OUTPUT_ALL;
+            } else if (strcmp(arg, "edges") == 0) {
+                outputEvery = OUTPUT_EDGES;
+            } else if (atoi(arg) > 0) {
+                outputEvery = atoi(arg);
+            } else {
+                fprintf(stderr, "Unknown verbosity '%s'\n", arg);
+                usage(progName);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'q':
+            quantum = strcmp(arg, "max") == 0 ? QUANTUM_MAX : atoi(arg);
+            if (quantum <= 0) {
+                fprintf(stderr, "Error: quantum must be a positive number of ticks.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'S':
+            policy = NULL;
+            for (int i = 0; i < (int)(sizeof(policies) / sizeof(policies[0])); i++) {
+                if (strcmp(arg, policies[i].name) == 0) {
+                    policy = &policies[i];
+                }
+            }
+            if (!policy) {
+                fprintf(stderr, "Unknown scheduling policy '%s'\n", arg);
+                usage(progName);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'k':
+            runLimit = atoi(arg);
+            if (runLimit <= 0) {
+                fprintf(stderr, "Error: run limit must be a positive number of workers.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'P':
+            if (atoi(arg) <= 0) {
+                fprintf(stderr, "Error: payload size must be a positive number of bytes.\n");
+                exit(EXIT_FAILURE);
+            }
+            payloadBytes = atoi(arg);
+            break;
+        case 'T':
+            dispatcherThreads = atoi(arg);
+            if (dispatcherThreads < 0) {
+                fprintf(stderr, "Error: dispatcher threads must be non-negative.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        default:
+            usage(progName);
+            exit(EXIT_FAILURE);
+    }
+}
+
+/* name=value from -o, or a config file line; where says which for errors. */
+void applySetting(const char *name, const char *value, const char *where) {
+    if (*value == '\0' || strpbrk(value, " \t")) {
+        fprintf(stderr, "%s: expected one value for '%s', got '%s'\n", where, name, value);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < (int)(sizeof(settings) / sizeof(settings[0])); i++) {
+        if (strcmp(name, settings[i].name) == 0) {
+            setOption(settings[i].opt, strdup(value));
+            return;
+        }
+    }
+    fprintf(stderr, "%s: unknown setting '%s'\n", where, name);
+    exit(EXIT_FAILURE);
+}
+
+/* Strip leading and trailing blanks in place. */
+char *trim(char *text) {
+    text += strspn(text, " \t\r\n");
+    char *end = text + strlen(text);
+    while (end > text && strchr(" \t\r\n", end[-1])) {
+        *--end = '\0';
+    }
+    return text;
+}
+
+/*
+ * A config file has one "name = value" per line, with the names of the
+ * settings table; # starts a comment. Later lines and later options win.
+ */
+void readConfig(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    char line[512];
+    char where[600];
+    for (int number = 1; fgets(line, sizeof(line), file); number++) {
+        snprintf(where, sizeof(where), "%s:%d", path, number);
+        if (!strchr(line, '\n') && !feof(file)) {
+            fprintf(stderr, "%s: line too long\n", where);
+            exit(EXIT_FAILURE);
+        }
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        char *equals = strchr(line, '=');
+        if (!equals) {
+            if (*trim(line) != '\0') {
+                fprintf(stderr, "%s: expected name = value\n", where);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+        *equals = '\0';
+        char *name = trim(line);
+        if (*name == '\0' || strpbrk(name, " \t")) {
+            fprintf(stderr, "%s: expected name = value\n", where);
+            exit(EXIT_FAILURE);
+        }
+        applySetting(name, trim(equals + 1), where);
+    }
+    fclose(file);
+}
+
 int main(int argc, char *argv[]) {
-    int numProcs = 5;
-    int simul = 2;
-    int timeLimit = 5;
-    int interval = 100;
+    int opt;
 
-    logFile = fopen("oss.log", "w");
-    if (!logFile) {
-        perror("fopen failed");
+    progName = argv[0];
+    mainThread = pthread_self();
+    policy = &policies[POLICY_RR];
+    while ((opt = getopt(argc, argv, "hf:o:n:s:t:i:w:g:l:r:a:C:m:e:d:c:pL:R:v:T:q:P:S:k:")) != -1) {
+        switch (opt) {
+            case 'f':
+                readConfig(optarg);
+                break;
+            case 'o': {
+                char *equals = strchr(optarg, '=');
+                if (!equals) {
+                    fprintf(stderr, "Error: -o takes name=value.\n");
+                    exit(EXIT_FAILURE);
+                }
+                *equals = '\0';
+                applySetting(optarg, equals + 1, "-o");
+                break;
+            }
+            case 'h':
+            case '?':
+                usage(argv[0]);
+                exit(opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+            default:
+                setOption(opt, optarg);
+        }
+    }
+
+    if (engine == ENGINE_FIBER && (requested || usePool || dispatch == DISPATCH_BROADCAST)) {
+        fprintf(stderr, "Error: fiber workers live inside oss; they can't be combined with -m, -p or broadcast dispatch.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (engine == ENGINE_FIBER) {
+        transport = &fiberTransport;
+    } else {
+        transport = requested ? requested : transportById(TRANSPORT_SYSV);
+    }
+    if (engine == ENGINE_FIBER && placementPolicy != PLACE_NONE) {
+        fprintf(stderr, "Error: fiber workers run on oss's own scheduler threads; -a places worker processes.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (placementCpus && placementPolicy == PLACE_NONE) {
+        fprintf(stderr, "Error: -C needs a placement policy (-a).\n");
+        exit(EXIT_FAILURE);
+    }
+    if (placementInit(&placement, placementPolicy, placementCpus) == -1) {
+        exit(EXIT_FAILURE);
+    }
+    if (quantum > 1 && dispatch == DISPATCH_BROADCAST) {
+        fprintf(stderr, "Error: broadcast dispatch ticks every worker every tick; it can't be combined with -q.\n");
+        exit(EXIT_FAILURE);
+    }
+    if ((runLimit > 0 || policy != &policies[POLICY_RR]) && dispatch == DISPATCH_BROADCAST) {
+        fprintf(stderr, "Error: broadcast dispatch ticks every worker every tick; it can't be combined with -S or -k.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (payloadBytes > 0 && dispatch == DISPATCH_BROADCAST) {
+        fprintf(stderr, "Error: payloads ride on tick messages, which broadcast dispatch doesn't send.\n");
         exit(EXIT_FAILURE);
     }
 
-    shmid = shmget(SHM_KEY, sizeof(SharedClock), IPC_CREAT | 0666);
+    if (!logPath) {
+        logPath = logMode == LOG_BINARY ? "oss.bin" : "oss.log";
+    }
+    if (logOpen(logPath, logMode) == -1) {
+        perror("logOpen failed");
+        exit(EXIT_FAILURE);
+    }
+
+    if (traceDir) {
+        if (mkdir(traceDir, 0755) == -1 && errno != EEXIST) {
+            perror("mkdir failed");
+            exit(EXIT_FAILURE);
+        }
+        if (traceOpen(traceDir, TRACE_ROLE_OSS, getpid(), TRACE_OSS_RECORDS) == -1) {
+            perror("traceOpen failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    initProcessTable(simul);
+
+    shmid = shmget(IPC_PRIVATE, segmentSize(simul), IPC_CREAT | 0600);
     if (shmid == -1) {
         perror("shmget failed");
         exit(EXIT_FAILURE);
     }
+    char shmidStr[16];
+    snprintf(shmidStr, sizeof(shmidStr), "%d", shmid);
+    setenv(SEGMENT_ENV, shmidStr, 1);
 
-    simClock = (SharedClock *)shmat(shmid, NULL, 0);
-    if (simClock == (void *)-1) {
+    segment = (SharedSegment *)shmat(shmid, NULL, 0);
+    if (segment == (void *)-1) {
         perror("shmat failed");
         exit(EXIT_FAILURE);
     }
+    simClock = &segment->clock;
+    segment->ossPid = getpid();
+    segment->transport = transport->id;
+    segment->capacity = simul;
+    segment->outputEvery = outputEvery;
+    segment->broadcast = dispatch == DISPATCH_BROADCAST;
+    segment->tickNanos = TICK_NANOS;
+    segment->payloadBytes = payloadBytes;
+    strcpy(segment->traceDir, traceDir ? traceDir : "");
+    segment->arenaShmid = -1;
+    segment->statsShmid = -1;
+    segment->msqid = -1;
+    atomic_store(&segment->tickEpoch, 0);
+    atomic_store(&segment->tickSleepers, 0);
+    atomic_store(&segment->replyBell, 0);
+    atomic_store(&segment->bellSleepers, 0);
 
-    msqid = msgget(MSG_KEY, IPC_CREAT | 0666);
-    if (msqid == -1) {
-        perror("msgget failed");
-        exit(EXIT_FAILURE);
+    /* A leftover segment under our key belongs to a dead oss that had our pid. */
+    statsShmid = shmget(statsKey(getpid()), statsSize(simul), IPC_CREAT | IPC_EXCL | 0644);
+    if (statsShmid == -1 && errno == EEXIST) {
+        shmctl(shmget(statsKey(getpid()), 0, 0), IPC_RMID, NULL);
+        statsShmid = shmget(statsKey(getpid()), statsSize(simul), IPC_CREAT | IPC_EXCL | 0644);
+    }
+    if (statsShmid == -1) {
+        perror("shmget failed");
+        cleanup(1);
+    }
+    stats = (StatsSegment *)shmat(statsShmid, NULL, 0);
+    if (stats == (void *)-1) {
+        perror("shmat failed");
+        statsShmid = -1;
+        cleanup(1);
     }
+    memset(stats, 0, statsSize(simul));
+    stats->ossPid = getpid();
+    stats->capacity = simul;
+    atomic_store(&stats->running, 1);
+    stats->placement = placementPolicy;
+    stats->ossCpu = placement.ossCpu;
+    segment->statsShmid = statsShmid;
 
-    signal(SIGALRM, cleanup);
-    signal(SIGINT, cleanup);
-    alarm(60);
+    if (transport->open(segment, simul) == -1) {
+        perror("transport setup failed");
+        cleanup(1);
+    }
+
+    if (payloadBytes > 0) {
+        arenaShmid = shmget(IPC_PRIVATE, arenaSize(payloadBytes, 2 * simul), IPC_CREAT | 0600);
+        if (arenaShmid == -1) {
+            perror("shmget failed");
+            cleanup(1);
+        }
+        arena = (PayloadArena *)shmat(arenaShmid, NULL, 0);
+        if (arena == (void *)-1) {
+            perror("shmat failed");
+            cleanup(1);
+        }
+        arenaInit(arena, payloadBytes, 2 * simul);
+        segment->arenaShmid = arenaShmid;
+    }
+
+    /* No SA_RESTART, so a blocked wait sees the signal and returns. */
+    struct sigaction stop = {0};
+    stop.sa_handler = stopRequested;
+    sigaction(SIGALRM, &stop, NULL);
+    sigaction(SIGINT, &stop, NULL);
+    runStart = wallNanos();
+    alarm(wallLimit);
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    sigchldFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sigchldFd == -1) {
+        perror("signalfd failed");
+        exit(EXIT_FAILURE);
+    }
 
-    simClock->seconds = 0;
-    simClock->nanoseconds = 0;
+    setClock(0);
+    initShards();
+    if (placeOss(&placement) == -1) {
+        perror("placeOss failed");
+    }
+    if (usePool) {
+        startPool(simul);
+    }
 
+    srand(seed);
     int childrenLaunched = 0;
-    int childrenRunning = 0;
+    runStart = wallNanos();
 
     while (childrenLaunched < numProcs || childrenRunning > 0) {
-        if (childrenLaunched < numProcs && childrenRunning < simul) {
-            pid_t pid = fork();
-            if (pid == 0) {
-                char maxSecStr[10], maxNanoStr[10];
-                int maxSec = rand() % timeLimit + 1;
-                int maxNano = rand() % 1000000000;
-                snprintf(maxSecStr, 10, "%d", maxSec);
-                snprintf(maxNanoStr, 10, "%d", maxNano);
-                execl("./worker", "./worker", maxSecStr, maxNanoStr, (char *)NULL);
-                perror("execl failed");
-                exit(EXIT_FAILURE);
-            } else if (pid > 0) {
-                for (int i = 0; i < MAX_CHILDREN; i++) {
-                    if (!processTable[i].occupied) {
-                        processTable[i].occupied = 1;
-                        processTable[i].pid = pid;
-                        processTable[i].startSec = simClock->seconds;
-                        processTable[i].startNano = simClock->nanoseconds;
-                        processTable[i].messagesSent = 0;
-                        break;
-                    }
+        stopIfSignalled();
+        /*
+         * Tick mode launches one worker per tick. In event mode every free
+         * slot is filled at once: a launch per tick would make the ramp to
+         * simul workers cost simul ticks of messages to everyone already
+         * running, which grows with the square of simul.
+         */
+        while (childrenLaunched < numProcs && childrenRunning < simul) {
+            int slot = allocSlot();
+            long long now = clockNanos();
+            segment->slots[slot].info.startNanos = now;
+
+            int maxSec = rand() % timeLimit + 1;
+            int maxNano = rand() % 1000000000;
+
+            long long launchedAt = wallNanos();
+            traceEvent(TRACE_LAUNCH, slot, 0, childrenLaunched, now);
+            pid_t pid = launchWorker(slot, maxSec, maxNano);
+            processTable[slot].pid = pid;
+            processTable[slot].startSec = clockSeconds(now);
+            processTable[slot].startNano = clockNanoseconds(now);
+            processTable[slot].iterations = 0;
+            processTable[slot].granted = 0;
+            processTable[slot].launchId = childrenLaunched;
+            processTable[slot].deadline = terminationTick(now, maxSec, maxNano);
+            processTable[slot].launchedAt = launchedAt;
+            statsAdd(&stats->slots[slot].oss.launches, 1);
+            processTable[slot].replied = 0;
+            processTable[slot].priority = policy == &policies[POLICY_PRIORITY] ? rand() % PRIORITY_CLASSES : 0;
+            processTable[slot].queued = 0;
+            if (dispatch != DISPATCH_BROADCAST) {
+                pushReady(slot);
+            }
+            if (clockMode == CLOCK_EVENT) {
+                armTimer(processTable[slot].deadline, slot);
+                if (quantum > 1) {
+                    armTimer(now + TICK_NANOS, slot);
                 }
-                childrenLaunched++;
-                childrenRunning++;
+            }
+            childrenLaunched++;
+            childrenRunning++;
+            if (clockMode == CLOCK_TICK) {
+                break;
+            }
+        }
+
+        if (clockMode == CLOCK_EVENT) {
+            /*
+             * Nothing observable happens between events: skip straight to the
+             * next worker deadline. Workers the run limit held back are due a
+             * grant on the very next tick, as is a launch that had no slot.
+             */
+            long long next = nextDeadline();
+            if ((childrenLaunched < numProcs && childrenRunning < simul) || readyBacklog || next < 0) {
+                incrementClock();
             } else {
-                perror("fork failed");
-                exit(EXIT_FAILURE);
+                setClock(next);
             }
+        } else {
+            incrementClock();
         }
 
-        incrementClock(childrenRunning);
+        dispatchTick();
+        reapChildren();
+        publishStats();
 
-        struct msgbuf msg;
-        for (int i = 0; i < MAX_CHILDREN; i++) {
-            if (processTable[i].occupied) {
-                msg.mtype = processTable[i].pid;
-                msgsnd(msqid, &msg, MSG_SIZE, 0);
-                fprintf(logFile, "OSS: Sending message to worker %d PID %d at time %d:%d\n", i, processTable[i].pid, simClock->seconds, simClock->nanoseconds);
-                msgrcv(msqid, &msg, MSG_SIZE, processTable[i].pid, 0);
-                fprintf(logFile, "OSS: Receiving message from worker %d PID %d at time %d:%d\n", i, processTable[i].pid, simClock->seconds, simClock->nanoseconds);
-                if (msg.mtext == 0) {
-                    fprintf(logFile, "OSS: Worker %d PID %d is planning to terminate.\n", i, processTable[i].pid);
-                    waitpid(processTable[i].pid, NULL, 0);
-                    processTable[i].occupied = 0;
-                    childrenRunning--;
-                } else {
-                    processTable[i].messagesSent++;
-                }
-            }
+        if (clockMode == CLOCK_TICK) {
+            usleep(interval * 1000);
         }
+    }
+
+    stopShards();
+    if (usePool) {
+        stopPool();
+    }
+    while (liveChildren > 0) {
+        pollChildren(-1);
+        stopIfSignalled();
+    }
+    if (launchLatencyCount > 0) {
+        fprintf(stderr, "OSS: %d launches, mean launch-to-first-reply %.1f us\n",
+                (int)launchLatencyCount, launchLatencyTotal / 1000.0 / launchLatencyCount);
+    }
+    if (finishedWorkers > 0) {
+        double simSeconds = (double)clockNanos() / NANOS_PER_SEC;
+        fprintf(stderr, "OSS: %s scheduling, %d finished in %.3f simulated s (%.2f per s), "
+                        "turnaround mean %.3f s max %.3f s, mean ready wait %.2f dispatch rounds over %d grants\n",
+                policy->name, finishedWorkers, simSeconds, finishedWorkers / simSeconds,
+                (double)turnaroundTotal / finishedWorkers / NANOS_PER_SEC, (double)turnaroundMax / NANOS_PER_SEC,
+                grantsMade > 0 ? (double)readyWaitTotal / grantsMade : 0.0, grantsMade);
+        fprintf(stderr, "OSS: finished workers ran %lld iterations, %.1f each\n", iterationsTotal,
+                (double)iterationsTotal / finishedWorkers);
+    }
 
-        usleep(interval * 1000);
+    reportStats(simul);
+    if (summaryPath) {
+        writeSummary(summaryPath, wallNanos() - runStart, "ok");
     }
 
     cleanup(0);
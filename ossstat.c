@@ -0,0 +1,263 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "affinity.h"
+#include "stats.h"
+
+/* Reprint the column headings every this many lines, as vmstat does. */
+#define HEADER_EVERY 20
+
+/* Sums over every slot, taken at one instant. */
+typedef struct {
+    long long wall;
+    long long simNanos;
+    int workers;
+    unsigned long long finished;
+    unsigned long long launches;
+    unsigned long long messages;
+    unsigned long long replies;
+    unsigned long long roundTripTotal;
+    unsigned long long roundTripMax;
+    unsigned long long sendBlocked;
+    unsigned long long receiveBlocked;
+    unsigned long long firstReplies;
+    unsigned long long firstReplyTotal;
+    unsigned long long workerTicks;
+    unsigned long long workerReceiveBlocked;
+    unsigned long long workerSendBlocked;
+    unsigned long long migrations;
+} Snapshot;
+
+static void takeSnapshot(StatsSegment *stats, Snapshot *snap) {
+    memset(snap, 0, sizeof(*snap));
+    snap->wall = statsNow();
+    snap->simNanos = atomic_load_explicit(&stats->simNanos, memory_order_relaxed);
+    snap->workers = atomic_load_explicit(&stats->workers, memory_order_relaxed);
+    snap->finished = atomic_load_explicit(&stats->finished, memory_order_relaxed);
+    snap->migrations = statsRead(&stats->ossMigrations);
+    for (int i = 0; i < stats->capacity; i++) {
+        OssSlotStats *oss = &stats->slots[i].oss;
+        WorkerSlotStats *worker = &stats->slots[i].worker;
+        snap->launches += statsRead(&oss->launches);
+        snap->messages += statsRead(&oss->messages);
+        snap->replies += statsRead(&oss->replies);
+        snap->roundTripTotal += statsRead(&oss->roundTripTotal);
+        if (statsRead(&oss->roundTripMax) > snap->roundTripMax) {
+            snap->roundTripMax = statsRead(&oss->roundTripMax);
+        }
+        snap->sendBlocked += statsRead(&oss->sendBlocked);
+        snap->receiveBlocked += statsRead(&oss->receiveBlocked);
+        snap->firstReplies += statsRead(&oss->firstReplies);
+        snap->firstReplyTotal += statsRead(&oss->firstReplyTotal);
+        snap->workerTicks += statsRead(&worker->ticks);
+        snap->workerReceiveBlocked += statsRead(&worker->receiveBlocked);
+        snap->workerSendBlocked += statsRead(&worker->sendBlocked);
+        snap->migrations += statsRead(&worker->migrations);
+    }
+}
+
+/* Mean of a nanosecond total over count events, in microseconds; 0 when nothing happened. */
+static double meanMicros(unsigned long long total, unsigned long long count) {
+    return count > 0 ? total / 1000.0 / count : 0.0;
+}
+
+static void printHeader(void) {
+    printf("%9s %7s %8s %8s %9s %9s %10s %5s %5s %9s %9s %9s %7s\n", "sim-s", "workers", "launch/s", "done/s",
+           "msgs/s", "rtt-us", "maxrtt-us", "send%", "wait%", "wtick-us", "wsend-us", "first-us", "migr/s");
+}
+
+/* One line of rates over the interval from before to after. */
+static void printRates(const Snapshot *before, const Snapshot *after) {
+    double seconds = (after->wall - before->wall) / 1e9;
+    double wallNanos = after->wall - before->wall;
+    unsigned long long replies = after->replies - before->replies;
+    unsigned long long ticks = after->workerTicks - before->workerTicks;
+
+    printf("%9.3f %7d %8.0f %8.0f %9.0f %9.1f %10.1f %5.1f %5.1f %9.1f %9.1f %9.1f %7.0f\n", after->simNanos / 1e9,
+           after->workers, (after->launches - before->launches) / seconds,
+           (after->finished - before->finished) / seconds, (after->messages - before->messages) / seconds,
+           meanMicros(after->roundTripTotal - before->roundTripTotal, replies), after->roundTripMax / 1000.0,
+           100.0 * (after->sendBlocked - before->sendBlocked) / wallNanos,
+           100.0 * (after->receiveBlocked - before->receiveBlocked) / wallNanos,
+           meanMicros(after->workerReceiveBlocked - before->workerReceiveBlocked, ticks),
+           meanMicros(after->workerSendBlocked - before->workerSendBlocked, ticks),
+           meanMicros(after->firstReplyTotal - before->firstReplyTotal, after->firstReplies - before->firstReplies),
+           (after->migrations - before->migrations) / seconds);
+}
+
+/* Cumulative counters for each slot that has been used. */
+static void printSlots(StatsSegment *stats) {
+    printf("%5s %8s %10s %10s %10s %9s %10s %9s %9s %9s %9s %4s %10s\n", "slot", "launches", "messages",
+           "replies", "iterations", "rtt-us", "maxrtt-us", "send-ms", "wait-ms", "first-us", "wtick-us", "cpu",
+           "migrations");
+    for (int i = 0; i < stats->capacity; i++) {
+        OssSlotStats *oss = &stats->slots[i].oss;
+        WorkerSlotStats *worker = &stats->slots[i].worker;
+        if (statsRead(&oss->launches) == 0) {
+            continue;
+        }
+        printf("%5d %8llu %10llu %10llu %10llu %9.1f %10.1f %9.1f %9.1f %9.1f %9.1f %4d %10llu\n", i,
+               statsRead(&oss->launches), statsRead(&oss->messages), statsRead(&oss->replies), statsRead(&oss->iterations),
+               meanMicros(statsRead(&oss->roundTripTotal), statsRead(&oss->replies)),
+               statsRead(&oss->roundTripMax) / 1000.0, statsRead(&oss->sendBlocked) / 1e6,
+               statsRead(&oss->receiveBlocked) / 1e6,
+               meanMicros(statsRead(&oss->firstReplyTotal), statsRead(&oss->firstReplies)),
+               meanMicros(statsRead(&worker->receiveBlocked), statsRead(&worker->ticks)),
+               atomic_load_explicit(&worker->cpu, memory_order_relaxed), statsRead(&worker->migrations));
+    }
+}
+
+/* How many concurrent runs findOss will list. */
+#define MAX_RUNS 256
+
+/*
+ * The pid of the only oss running when pid is 0, found from the stats keys
+ * in /proc/sysvipc/shm. Returns -1 after saying why when there is none or
+ * more than one to choose from.
+ */
+static pid_t findOss(pid_t pid) {
+    if (pid > 0) {
+        return pid;
+    }
+    FILE *list = fopen("/proc/sysvipc/shm", "r");
+    if (!list) {
+        perror("ossstat: cannot list shared memory");
+        return -1;
+    }
+    pid_t runs[MAX_RUNS];
+    int found = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), list)) {
+        long key = strtol(line, NULL, 10);
+        if ((key & ~(long)STATS_PID_MASK) != STATS_KEY_BASE) {
+            continue;
+        }
+        pid_t candidate = key & STATS_PID_MASK;
+        if ((kill(candidate, 0) == 0 || errno != ESRCH) && found < MAX_RUNS) {
+            runs[found++] = candidate;
+        }
+    }
+    fclose(list);
+
+    if (found == 0) {
+        fprintf(stderr, "ossstat: no running oss\n");
+        return -1;
+    }
+    if (found > 1) {
+        fprintf(stderr, "ossstat: %d oss runs, pick one with -p:", found);
+        for (int i = 0; i < found; i++) {
+            fprintf(stderr, " %d", (int)runs[i]);
+        }
+        fprintf(stderr, "\n");
+        return -1;
+    }
+    return runs[0];
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-s] [-p pid] [delay [count]]\n", prog);
+    fprintf(stderr, "  Print a running oss's message rates every delay seconds (default 1),\n");
+    fprintf(stderr, "  count times or until oss exits.\n");
+    fprintf(stderr, "  -s  print each slot's totals so far once instead\n");
+    fprintf(stderr, "  -p  watch the oss with this pid (needed when several are running)\n");
+}
+
+/*
+ * Watch a running oss through its stats segment, vmstat style. The segment
+ * is attached read-only, so watching never slows oss down beyond the cache
+ * misses of reading its counters.
+ */
+int main(int argc, char *argv[]) {
+    int perSlot = 0;
+    pid_t ossPid = 0;
+    double delay = 1.0;
+    long count = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hsp:")) != -1) {
+        switch (opt) {
+            case 's':
+                perSlot = 1;
+                break;
+            case 'p':
+                ossPid = atoi(optarg);
+                if (ossPid <= 0 || ossPid > STATS_PID_MASK) {
+                    fprintf(stderr, "Error: -p needs an oss pid.\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind < argc) {
+        delay = atof(argv[optind++]);
+        if (delay <= 0) {
+            fprintf(stderr, "Error: delay must be a positive number of seconds.\n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind < argc) {
+        count = atol(argv[optind++]);
+        if (count <= 0) {
+            fprintf(stderr, "Error: count must be a positive number.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    ossPid = findOss(ossPid);
+    if (ossPid == -1) {
+        return EXIT_FAILURE;
+    }
+    int shmid = shmget(statsKey(ossPid), 0, 0);
+    if (shmid == -1) {
+        fprintf(stderr, "ossstat: no running oss with pid %d\n", (int)ossPid);
+        return EXIT_FAILURE;
+    }
+    StatsSegment *stats = (StatsSegment *)shmat(shmid, NULL, SHM_RDONLY);
+    if (stats == (void *)-1) {
+        perror("shmat failed");
+        return EXIT_FAILURE;
+    }
+
+    printf("oss %d: %s placement", (int)stats->ossPid, placementName(stats->placement));
+    if (stats->ossCpu >= 0) {
+        printf(", oss on cpu %d", stats->ossCpu);
+    }
+    printf("\n");
+    if (perSlot) {
+        printSlots(stats);
+        shmdt(stats);
+        return EXIT_SUCCESS;
+    }
+
+    struct timespec nap = {(time_t)delay, (long)((delay - (time_t)delay) * 1e9)};
+    Snapshot before, after;
+    takeSnapshot(stats, &before);
+    for (long line = 0; count < 0 || line < count; line++) {
+        nanosleep(&nap, NULL);
+        takeSnapshot(stats, &after);
+        if (line % HEADER_EVERY == 0) {
+            printHeader();
+        }
+        printRates(&before, &after);
+        fflush(stdout);
+        before = after;
+        if (!atomic_load(&stats->running) || (kill(stats->ossPid, 0) == -1 && errno == ESRCH)) {
+            printf("oss %d has exited\n", (int)stats->ossPid);
+            break;
+        }
+    }
+
+    shmdt(stats);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,488 @@
+#ifndef SHARED_H
+#define SHARED_H
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arena.h"
+
+/*
+ * Every IPC object of a run is created IPC_PRIVATE, so any number of oss
+ * instances can share a host. oss puts the segment's shmid in this
+ * environment variable for the workers it execs, and the segment in turn
+ * holds the ids of everything else.
+ */
+#define SEGMENT_ENV "OSS_SEGMENT"
+
+/*
+ * oss addresses a worker with mtype pid + TO_WORKER_OFFSET and the worker
+ * answers with its bare pid. Pids stay below PID_MAX_LIMIT (2^22), so the two
+ * directions never share a type: oss can't receive its own outbound message,
+ * and ANY_REPLY_TYPE picks up the lowest-typed reply from any worker. The
+ * synthetic pids of -e fiber tasks start at 2^22 (FIBER_PID_BASE in fiber.h);
+ * they are fine only because tasks never use the SysV queue.
+ */
+#define TO_WORKER_OFFSET (1L << 22)
+#define toWorkerType(pid) ((long)(pid) + TO_WORKER_OFFSET)
+#define ANY_REPLY_TYPE (-(TO_WORKER_OFFSET - 1))
+
+#define NANOS_PER_SEC 1000000000LL
+
+/*
+ * What oss asks of a worker in mtext. Workers answer 1 to continue, 0 when
+ * done. count carries the grant size in ticks with MSG_TICK and the number
+ * of iterations the worker ran for it in the reply. A MSG_TICK may carry a
+ * payload in the arena (oss -P); the worker releases it once read. A zero
+ * length means there is none.
+ */
+#define MSG_TICK 1
+#define MSG_ASSIGN 2
+#define MSG_EXIT 3
+
+/* Worker progress lines: every iteration, every N iterations, or only start and end. */
+#define OUTPUT_ALL 1
+#define OUTPUT_EDGES 0
+
+/* Transport backends; see transport.h. */
+#define TRANSPORT_SYSV 0
+#define TRANSPORT_RING 1
+#define TRANSPORT_FUTEX 2
+#define TRANSPORT_MQUEUE 3
+#define TRANSPORT_SOCKET 4
+#define TRANSPORT_FIBER 5
+#define TRANSPORT_MPSC 6
+
+/* Must be a power of two so the ring indexes can wrap with a mask. */
+#define RING_SIZE 8
+#define RING_SPINS 1000
+#define RING_YIELDS 1000
+
+/*
+ * The simulated clock is one 64-bit nanosecond counter. oss publishes it with
+ * a release store and readers take an acquire load, so any process can read
+ * it at any time and always gets a value oss actually wrote; there is no
+ * seconds/nanoseconds pair to tear. clockSeconds()/clockNanoseconds() give
+ * the split view the logs print.
+ */
+typedef struct {
+    _Atomic long long nanos;
+} SharedClock;
+
+struct msgbuf {
+    long mtype;
+    int mtext;
+    int count;
+    PayloadHandle payload;
+};
+
+/*
+ * Single-producer/single-consumer ring of messages. The producer only ever
+ * writes tail and the consumer only ever writes head, so a push or pop is a
+ * couple of loads and one release store with no kernel involvement.
+ * head and tail live on separate cache lines so the two sides don't
+ * bounce a line back and forth on every message.
+ * With the futex transport a consumer with nothing to read sets sleeping and
+ * waits on tail, and the producer only makes the wake call when it sees it.
+ */
+typedef struct {
+    _Alignas(64) _Atomic unsigned int head;
+    _Atomic unsigned int sleeping;
+    _Alignas(64) _Atomic unsigned int tail;
+    _Alignas(64) struct msgbuf buf[RING_SIZE];
+} MsgRing;
+
+/*
+ * oss records the launch time of each slot's worker here before forking it,
+ * so the worker's termination time doesn't depend on when it gets scheduled.
+ * Pool workers also read their next lifetime from here on MSG_ASSIGN, and
+ * every MSG_TICK grants the ticks from grantStart up to grantEnd.
+ */
+typedef struct {
+    long long startNanos;
+    long long grantStart;
+    long long grantEnd;
+    int maxSec;
+    int maxNano;
+    unsigned int startEpoch;
+} SlotInfo;
+
+/*
+ * Broadcast dispatch: instead of a message per worker, oss bumps tickEpoch
+ * once a tick and each worker posts its answer (1 or 0, as in mtext) for
+ * that epoch here. A worker answers every epoch after its slot's startEpoch.
+ */
+typedef struct {
+    _Alignas(64) _Atomic unsigned int epoch;
+    int answer;
+} TickAnswer;
+
+/*
+ * A worker holding a grant of several ticks sleeps on grantBell until the
+ * clock reaches grantEnd, and oss rings it when that slot's grant-end timer
+ * fires. Watching the clock itself would mean every such worker polling it,
+ * or being woken on every tick whether its grant is up or not.
+ */
+typedef struct {
+    MsgRing toWorker;
+    MsgRing toOss;
+    SlotInfo info;
+    TickAnswer answer;
+    _Alignas(64) _Atomic unsigned int grantBell;
+    _Atomic unsigned int grantSleeping;
+} SharedSlot;
+
+/*
+ * Multi-producer/single-consumer queue of replies for the mpsc transport:
+ * every worker appends to the one queue and oss drains whatever has piled
+ * up in a single pass, instead of checking each slot's ring in turn.
+ *
+ * A producer claims a position with one fetch_add on tail and fills the
+ * cell it maps to; the cell's seq turns pos + 1 once the reply can be read
+ * and pos + cells once oss has taken it and the producer a lap later may
+ * reuse it. Only the producer that finds its reply at the head (the queue
+ * was empty) rings the reply bell, so oss is woken once per batch however
+ * many workers answer.
+ */
+typedef struct {
+    _Atomic unsigned int seq;
+    int slot;
+    struct msgbuf msg;
+} ReplyCell;
+
+typedef struct {
+    unsigned int mask;
+    _Alignas(64) _Atomic unsigned int head;
+    _Alignas(64) _Atomic unsigned int tail;
+    _Alignas(64) ReplyCell cells[];
+} ReplyQueue;
+
+/* Room for two replies per slot, rounded up to a power of two. */
+static inline unsigned int replyQueueCells(int capacity) {
+    unsigned int cells = 2;
+    while (cells < 2u * (unsigned int)capacity) {
+        cells <<= 1;
+    }
+    return cells;
+}
+
+/*
+ * Everything oss shares with its workers lives in this one segment: a small
+ * header followed by one SharedSlot per process table entry and then the
+ * ReplyQueue. oss sizes it
+ * for simul slots; workers attach without knowing the size and read it from
+ * capacity.
+ *
+ * replyBell is how futex-transport workers wake oss, which may be waiting on
+ * any number of slots at once: a worker bumps it after every reply and only
+ * enters the kernel when bellSleepers says an oss thread is waiting on it.
+ * Broadcast workers ring it too after posting a TickAnswer. tickEpoch and
+ * tickSleepers are the same arrangement in the other direction, with one
+ * wake for every worker.
+ */
+typedef struct {
+    SharedClock clock;
+    pid_t ossPid;
+    int transport;
+    int capacity;
+    int outputEvery;
+    int broadcast;
+    long long tickNanos;
+    unsigned int payloadBytes;
+    /* The run's other SysV objects, or -1 when it doesn't have them. */
+    int arenaShmid;
+    int statsShmid;
+    int msqid;
+    /* Where workers write their trace files (oss -R); empty when not tracing. */
+    char traceDir[256];
+    _Alignas(64) _Atomic unsigned int tickEpoch;
+    _Atomic unsigned int tickSleepers;
+    _Alignas(64) _Atomic unsigned int replyBell;
+    _Atomic unsigned int bellSleepers;
+    _Alignas(64) SharedSlot slots[];
+} SharedSegment;
+
+#define segmentSize(capacity) \
+    (sizeof(SharedSegment) + (size_t)(capacity) * sizeof(SharedSlot) + sizeof(ReplyQueue) + \
+     (size_t)replyQueueCells(capacity) * sizeof(ReplyCell))
+
+static inline ReplyQueue *segmentReplies(SharedSegment *segment) {
+    return (ReplyQueue *)&segment->slots[segment->capacity];
+}
+
+static inline long long clockRead(SharedClock *clock) {
+    return atomic_load_explicit(&clock->nanos, memory_order_acquire);
+}
+
+static inline void clockWrite(SharedClock *clock, long long nanos) {
+    atomic_store_explicit(&clock->nanos, nanos, memory_order_release);
+}
+
+static inline int clockSeconds(long long nanos) {
+    return (int)(nanos / NANOS_PER_SEC);
+}
+
+static inline int clockNanoseconds(long long nanos) {
+    return (int)(nanos % NANOS_PER_SEC);
+}
+
+static inline void ringReset(MsgRing *ring) {
+    atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->sleeping, 0, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, 0, memory_order_release);
+}
+
+static inline int ringPush(MsgRing *ring, const struct msgbuf *msg) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head == RING_SIZE) {
+        return 0;
+    }
+    ring->buf[tail & (RING_SIZE - 1)] = *msg;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+static inline int ringPop(MsgRing *ring, struct msgbuf *msg) {
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head == tail) {
+        return 0;
+    }
+    *msg = ring->buf[head & (RING_SIZE - 1)];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 1;
+}
+
+/*
+ * Back off while the other side catches up: spin first, since the reply is
+ * normally only a few microseconds away, then yield, then sleep so an idle
+ * worker between ticks doesn't keep a core busy.
+ */
+static inline void ringBackoff(int *attempts) {
+    struct timespec nap = {0, 50000};
+
+    if (*attempts < RING_SPINS) {
+        (*attempts)++;
+    } else if (*attempts < RING_SPINS + RING_YIELDS) {
+        (*attempts)++;
+        sched_yield();
+    } else {
+        nanosleep(&nap, NULL);
+    }
+}
+
+/* Wait until the clock reaches either time and return it. */
+static inline long long clockWaitUntil(SharedClock *clock, long long first, long long second) {
+    long long now;
+    int attempts = 0;
+
+    while ((now = clockRead(clock)) < first && now < second) {
+        ringBackoff(&attempts);
+    }
+    return now;
+}
+
+static inline void ringSend(MsgRing *ring, const struct msgbuf *msg) {
+    int attempts = 0;
+    while (!ringPush(ring, msg)) {
+        ringBackoff(&attempts);
+    }
+}
+
+static inline void ringReceive(MsgRing *ring, struct msgbuf *msg) {
+    int attempts = 0;
+    while (!ringPop(ring, msg)) {
+        ringBackoff(&attempts);
+    }
+}
+
+static inline void replyQueueInit(ReplyQueue *queue, int capacity) {
+    unsigned int cells = replyQueueCells(capacity);
+
+    queue->mask = cells - 1;
+    for (unsigned int i = 0; i < cells; i++) {
+        atomic_store_explicit(&queue->cells[i].seq, i, memory_order_relaxed);
+    }
+    atomic_store_explicit(&queue->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&queue->tail, 0, memory_order_release);
+}
+
+/*
+ * Append slot's reply. Returns 1 if it went in at the head, i.e. oss had
+ * already taken everything before it and may be about to sleep. The fence
+ * pairs with the one in replyPop: either oss sees the new cell or we see
+ * its head.
+ */
+static inline int replyPush(ReplyQueue *queue, int slot, const struct msgbuf *msg) {
+    unsigned int pos = atomic_fetch_add_explicit(&queue->tail, 1, memory_order_relaxed);
+    ReplyCell *cell = &queue->cells[pos & queue->mask];
+    int attempts = 0;
+
+    while (atomic_load_explicit(&cell->seq, memory_order_acquire) != pos) {
+        ringBackoff(&attempts);
+    }
+    cell->slot = slot;
+    cell->msg = *msg;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load_explicit(&queue->head, memory_order_relaxed) == pos;
+}
+
+/* Take the oldest reply, if it has been filled in yet. Single consumer only. */
+static inline int replyPop(ReplyQueue *queue, int *slot, struct msgbuf *msg) {
+    unsigned int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    ReplyCell *cell = &queue->cells[head & queue->mask];
+
+    if (atomic_load_explicit(&cell->seq, memory_order_acquire) != head + 1) {
+        return 0;
+    }
+    *slot = cell->slot;
+    *msg = cell->msg;
+    atomic_store_explicit(&cell->seq, head + queue->mask + 1, memory_order_release);
+    atomic_store_explicit(&queue->head, head + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    return 1;
+}
+
+/*
+ * The segment is shared between processes, so these are plain (not
+ * FUTEX_PRIVATE) futex calls. A timeout of 0 waits until woken.
+ */
+static inline void futexWait(_Atomic unsigned int *word, unsigned int expected, long timeoutNanos) {
+    struct timespec timeout = {timeoutNanos / NANOS_PER_SEC, timeoutNanos % NANOS_PER_SEC};
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, timeoutNanos > 0 ? &timeout : NULL, NULL, 0);
+}
+
+static inline void futexWake(_Atomic unsigned int *word, int count) {
+    syscall(SYS_futex, word, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+/*
+ * Push, then wake the consumer if it has gone to sleep on tail. The fence
+ * pairs with the one in ringReceiveWait: either the consumer sees the new
+ * tail before it sleeps or we see its sleeping flag.
+ */
+static inline void ringSendWake(MsgRing *ring, const struct msgbuf *msg) {
+    ringSend(ring, msg);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->sleeping, memory_order_relaxed)) {
+        futexWake(&ring->tail, 1);
+    }
+}
+
+/* Spin briefly, then sleep on the ring's tail until the producer wakes us. */
+static inline void ringReceiveWait(MsgRing *ring, struct msgbuf *msg) {
+    int attempts = 0;
+
+    while (!ringPop(ring, msg)) {
+        if (attempts < RING_SPINS) {
+            attempts++;
+            continue;
+        }
+        unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        atomic_store_explicit(&ring->sleeping, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&ring->head, memory_order_relaxed) == tail) {
+            futexWait(&ring->tail, tail, 0);
+        }
+        atomic_store_explicit(&ring->sleeping, 0, memory_order_relaxed);
+    }
+}
+
+/*
+ * Worker: wait until the clock reaches either time, sleeping on the slot's
+ * grant bell. The fence pairs with the one in grantRing: either we see the
+ * clock oss set before we sleep or oss sees our sleeping flag.
+ */
+static inline long long grantWait(SharedClock *clock, SharedSlot *slot, long long first, long long second) {
+    long long now;
+    int attempts = 0;
+
+    while ((now = clockRead(clock)) < first && now < second) {
+        if (attempts < RING_SPINS) {
+            attempts++;
+            continue;
+        }
+        unsigned int seen = atomic_load_explicit(&slot->grantBell, memory_order_relaxed);
+        atomic_store_explicit(&slot->grantSleeping, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        now = clockRead(clock);
+        if (now < first && now < second) {
+            futexWait(&slot->grantBell, seen, 0);
+        }
+        atomic_store_explicit(&slot->grantSleeping, 0, memory_order_relaxed);
+    }
+    return now;
+}
+
+/* oss: the clock has reached slot's grant end; wake its worker if it sleeps. */
+static inline void grantRing(SharedSlot *slot) {
+    atomic_fetch_add_explicit(&slot->grantBell, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&slot->grantSleeping, memory_order_relaxed)) {
+        futexWake(&slot->grantBell, 1);
+    }
+}
+
+/* Worker side of the reply bell: call after pushing a reply. */
+static inline void bellRing(SharedSegment *segment) {
+    atomic_fetch_add(&segment->replyBell, 1);
+    if (atomic_load(&segment->bellSleepers) > 0) {
+        futexWake(&segment->replyBell, INT_MAX);
+    }
+}
+
+/*
+ * oss side: sleep until any worker rings after seen was read, or until
+ * timeoutNanos passes. Read seen before checking the rings; a reply pushed
+ * after that changes the bell, so the wait returns at once.
+ */
+static inline void bellWait(SharedSegment *segment, unsigned int seen, long timeoutNanos) {
+    atomic_fetch_add(&segment->bellSleepers, 1);
+    futexWait(&segment->replyBell, seen, timeoutNanos);
+    atomic_fetch_sub(&segment->bellSleepers, 1);
+}
+
+static inline unsigned int bellRead(SharedSegment *segment) {
+    return atomic_load(&segment->replyBell);
+}
+
+/* oss: start a new broadcast tick and wake every worker sleeping on it. */
+static inline unsigned int tickPublish(SharedSegment *segment) {
+    unsigned int epoch = atomic_fetch_add(&segment->tickEpoch, 1) + 1;
+    if (atomic_load(&segment->tickSleepers) > 0) {
+        futexWake(&segment->tickEpoch, INT_MAX);
+    }
+    return epoch;
+}
+
+/* Worker: wait for an epoch after last and return it. */
+static inline unsigned int tickWait(SharedSegment *segment, unsigned int last) {
+    unsigned int epoch;
+    int attempts = 0;
+
+    while ((epoch = atomic_load_explicit(&segment->tickEpoch, memory_order_acquire)) == last) {
+        if (attempts < RING_SPINS) {
+            attempts++;
+            continue;
+        }
+        atomic_fetch_add(&segment->tickSleepers, 1);
+        futexWait(&segment->tickEpoch, last, 0);
+        atomic_fetch_sub(&segment->tickSleepers, 1);
+    }
+    return epoch;
+}
+
+/* Worker: post this epoch's answer and let oss know. */
+static inline void tickAnswer(SharedSegment *segment, TickAnswer *answer, unsigned int epoch, int value) {
+    answer->answer = value;
+    atomic_store_explicit(&answer->epoch, epoch, memory_order_release);
+    bellRing(segment);
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+/*
+ * Unlike the run's other objects the stats segment has a key, so ossstat
+ * can find it from outside: the high bits mark it as an oss stats segment
+ * and the low 22 hold the oss pid (pids stay below 2^22), so concurrent
+ * runs never collide. Only oss's real pid goes here, never a fiber task's.
+ */
+#define STATS_KEY_BASE 0x4f000000
+#define STATS_PID_MASK ((1 << 22) - 1)
+#define statsKey(ossPid) ((key_t)(STATS_KEY_BASE | (ossPid)))
+
+/*
+ * Live counters for ossstat. oss creates this segment next to the main one
+ * and keeps it for the whole run; workers attach it as well, and ossstat
+ * attaches it read-only and turns the differences between two snapshots
+ * into rates. All times are wall-clock nanoseconds.
+ *
+ * Each counter has exactly one writer: oss's half of a slot is written by
+ * the dispatcher that owns the slot (launches by the main thread), the
+ * worker half by whichever worker holds the slot. A worker stops writing
+ * before it sends its final answer, since oss may give the slot to the
+ * next worker as soon as that answer arrives. Updates are therefore a
+ * relaxed load and store rather than a locked add, and the two halves sit
+ * on separate cache lines so oss and the worker don't trade the line on
+ * every message. Counters run on across the slot's occupants.
+ */
+typedef struct {
+    _Alignas(64) _Atomic unsigned long long launches;
+    _Atomic unsigned long long messages;
+    _Atomic unsigned long long replies;
+    /* Ticks the workers say they ran, from the counts in their replies. */
+    _Atomic unsigned long long iterations;
+    /* From handing the tick to the transport until its reply was read. */
+    _Atomic unsigned long long roundTripTotal;
+    _Atomic unsigned long long roundTripMax;
+    /* Inside the transport's send, and waiting for replies. */
+    _Atomic unsigned long long sendBlocked;
+    _Atomic unsigned long long receiveBlocked;
+    _Atomic unsigned long long firstReplies;
+    _Atomic unsigned long long firstReplyTotal;
+    _Atomic unsigned long long firstReplyMax;
+} OssSlotStats;
+
+typedef struct {
+    _Alignas(64) _Atomic unsigned long long ticks;
+    /* Waiting for the next tick, and handing back every answer but the final one. */
+    _Atomic unsigned long long receiveBlocked;
+    _Atomic unsigned long long sendBlocked;
+    /* The CPU the worker last took a tick on, and how often that changed. */
+    _Atomic int cpu;
+    _Atomic unsigned long long migrations;
+} WorkerSlotStats;
+
+typedef struct {
+    OssSlotStats oss;
+    WorkerSlotStats worker;
+} SlotStats;
+
+typedef struct {
+    pid_t ossPid;
+    int capacity;
+    /* Cleared once oss is shutting down. */
+    _Atomic int running;
+    _Atomic int workers;
+    _Atomic long long simNanos;
+    _Atomic unsigned long long finished;
+    /* oss -a: the placement policy, oss's CPU (-1 when not pinned) and how often oss changed CPU. */
+    int placement;
+    int ossCpu;
+    _Atomic unsigned long long ossMigrations;
+    _Alignas(64) SlotStats slots[];
+} StatsSegment;
+
+#define statsSize(capacity) (sizeof(StatsSegment) + (size_t)(capacity) * sizeof(SlotStats))
+
+static inline void statsAdd(_Atomic unsigned long long *counter, unsigned long long amount) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + amount,
+                          memory_order_relaxed);
+}
+
+static inline void statsMax(_Atomic unsigned long long *counter, unsigned long long value) {
+    if (value > atomic_load_explicit(counter, memory_order_relaxed)) {
+        atomic_store_explicit(counter, value, memory_order_relaxed);
+    }
+}
+
+static inline unsigned long long statsRead(_Atomic unsigned long long *counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static inline long long statsNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#endif
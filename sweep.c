@@ -0,0 +1,494 @@
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_AXES 32
+#define MAX_VALUES 64
+#define MAX_RESULTS 64
+
+/* One swept setting and the values it takes, in the order given. */
+typedef struct {
+    char *name;
+    char *values[MAX_VALUES];
+    int count;
+} Axis;
+
+typedef struct {
+    pid_t pid;
+    int status;
+    double seconds;
+    long long started;
+    /* The status oss reported, ok or timeout; NULL if it reported none. */
+    char *outcome;
+    /* Indexed like resultNames; NULL where the run didn't report it. */
+    char *results[MAX_RESULTS];
+} Job;
+
+static Axis axes[MAX_AXES];
+static int axisCount;
+static Job *jobs;
+static int jobCount;
+static int repeats = 1;
+static const char *outDir = "sweep.out";
+/* Result columns in the order the first finished run reported them. */
+static char *resultNames[MAX_RESULTS];
+static int resultCount;
+
+static long long nowNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Strip leading and trailing blanks in place. */
+static char *trim(char *text) {
+    text += strspn(text, " \t\r\n");
+    char *end = text + strlen(text);
+    while (end > text && strchr(" \t\r\n", end[-1])) {
+        *--end = '\0';
+    }
+    return text;
+}
+
+/*
+ * name=a,b,c from the command line or a grid file. Blanks around names and
+ * values are dropped; a value that is empty or still has a blank inside is
+ * an error rather than being cut short.
+ */
+static void addAxis(const char *spec, const char *where) {
+    char *copy = strdup(spec);
+    char *equals = strchr(copy, '=');
+    if (!equals) {
+        fprintf(stderr, "%s: expected name=value[,value...], got '%s'\n", where, spec);
+        exit(EXIT_FAILURE);
+    }
+    *equals = '\0';
+    char *name = trim(copy);
+    if (*name == '\0' || strpbrk(name, " \t")) {
+        fprintf(stderr, "%s: expected name=value[,value...], got '%s'\n", where, spec);
+        exit(EXIT_FAILURE);
+    }
+    if (axisCount == MAX_AXES) {
+        fprintf(stderr, "%s: more than %d settings\n", where, MAX_AXES);
+        exit(EXIT_FAILURE);
+    }
+    Axis *axis = &axes[axisCount++];
+    axis->name = name;
+    char *next = equals + 1;
+    while (next) {
+        char *value = next;
+        next = strchr(next, ',');
+        if (next) {
+            *next++ = '\0';
+        }
+        value = trim(value);
+        if (*value == '\0' || strpbrk(value, " \t")) {
+            fprintf(stderr, "%s: bad value '%s' for %s in '%s'\n", where, value, name, spec);
+            exit(EXIT_FAILURE);
+        }
+        if (axis->count == MAX_VALUES) {
+            fprintf(stderr, "%s: more than %d values for %s\n", where, MAX_VALUES, name);
+            exit(EXIT_FAILURE);
+        }
+        axis->values[axis->count++] = value;
+    }
+}
+
+/* Same format as an oss config file, except that a value may be a comma-separated list. */
+static void readGrid(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    char line[1024];
+    char where[600];
+    for (int number = 1; fgets(line, sizeof(line), file); number++) {
+        snprintf(where, sizeof(where), "%s:%d", path, number);
+        if (!strchr(line, '\n') && !feof(file)) {
+            fprintf(stderr, "%s: line too long\n", where);
+            exit(EXIT_FAILURE);
+        }
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+        if (*trim(line) != '\0') {
+            addAxis(line, where);
+        }
+    }
+    fclose(file);
+}
+
+/* The value axis takes in job; the last axis varies fastest, repeats faster still. */
+static const char *axisValue(int job, int axis) {
+    int index = job / repeats;
+    for (int i = axisCount - 1; i > axis; i--) {
+        index /= axes[i].count;
+    }
+    return axes[axis].values[index % axes[axis].count];
+}
+
+static int axisIndex(const char *name) {
+    for (int i = 0; i < axisCount; i++) {
+        if (strcmp(axes[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void jobPath(char *path, size_t size, int job, const char *suffix) {
+    snprintf(path, size, "%s/run-%d.%s", outDir, job, suffix);
+}
+
+/* Run oss for job with its stdout discarded and stderr kept next to its log. */
+static pid_t startJob(int job) {
+    char logPath[512], summaryPath[512], errPath[512];
+    jobPath(logPath, sizeof(logPath), job, "log");
+    jobPath(summaryPath, sizeof(summaryPath), job, "result");
+    jobPath(errPath, sizeof(errPath), job, "err");
+    unlink(summaryPath);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        char *args[2 * MAX_AXES + 8];
+        int argc = 0;
+        args[argc++] = "./oss";
+        for (int i = 0; i < axisCount; i++) {
+            char *setting = malloc(strlen(axes[i].name) + strlen(axisValue(job, i)) + 2);
+            sprintf(setting, "%s=%s", axes[i].name, axisValue(job, i));
+            args[argc++] = "-o";
+            args[argc++] = setting;
+        }
+        /* Each repeat draws different worker run times unless seed is swept. */
+        if (axisIndex("seed") == -1) {
+            char *setting = malloc(32);
+            snprintf(setting, 32, "seed=%d", job % repeats + 1);
+            args[argc++] = "-o";
+            args[argc++] = setting;
+        }
+        args[argc++] = "-l";
+        args[argc++] = logPath;
+        args[argc++] = "-r";
+        args[argc++] = summaryPath;
+        args[argc] = NULL;
+
+        int devnull = open("/dev/null", O_WRONLY);
+        int err = open(errPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (devnull >= 0) {
+            dup2(devnull, STDOUT_FILENO);
+        }
+        if (err >= 0) {
+            dup2(err, STDERR_FILENO);
+        }
+        execv("./oss", args);
+        perror("execv ./oss failed");
+        _exit(127);
+    } else if (pid < 0) {
+        perror("fork failed");
+        exit(EXIT_FAILURE);
+    }
+    jobs[job].pid = pid;
+    jobs[job].started = nowNanos();
+    return pid;
+}
+
+/* Wait for any running job; returns its index. */
+static int reapJob(void) {
+    int status;
+    pid_t pid;
+    while ((pid = wait(&status)) == -1 && errno == EINTR) {
+    }
+    if (pid == -1) {
+        perror("wait failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < jobCount; i++) {
+        if (jobs[i].pid == pid) {
+            jobs[i].pid = 0;
+            jobs[i].status = status;
+            jobs[i].seconds = (nowNanos() - jobs[i].started) / 1e9;
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int resultColumn(const char *name) {
+    for (int i = 0; i < resultCount; i++) {
+        if (strcmp(resultNames[i], name) == 0) {
+            return i;
+        }
+    }
+    if (resultCount == MAX_RESULTS) {
+        return -1;
+    }
+    resultNames[resultCount] = strdup(name);
+    return resultCount++;
+}
+
+/* Read the name=value line oss -r left for job. */
+static void readResults(int job) {
+    char path[512], line[4096];
+    jobPath(path, sizeof(path), job, "result");
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return;
+    }
+    if (fgets(line, sizeof(line), file)) {
+        for (char *pair = strtok(line, " \t\r\n"); pair; pair = strtok(NULL, " \t\r\n")) {
+            char *equals = strchr(pair, '=');
+            if (!equals) {
+                continue;
+            }
+            *equals = '\0';
+            if (strcmp(pair, "status") == 0) {
+                jobs[job].outcome = strdup(equals + 1);
+                continue;
+            }
+            int column = resultColumn(pair);
+            if (column >= 0) {
+                jobs[job].results[column] = strdup(equals + 1);
+            }
+        }
+    }
+    fclose(file);
+}
+
+/* ok, or how oss ended when it didn't finish and report. */
+static const char *jobStatus(int job, char *buffer, size_t size) {
+    int status = jobs[job].status;
+    if (jobs[job].outcome && strcmp(jobs[job].outcome, "ok") != 0) {
+        snprintf(buffer, size, "%s", jobs[job].outcome);
+    } else if (WIFSIGNALED(status)) {
+        snprintf(buffer, size, "signal %d", WTERMSIG(status));
+    } else if (WEXITSTATUS(status) != 0) {
+        snprintf(buffer, size, "exit %d", WEXITSTATUS(status));
+    } else if (resultCount == 0 || !jobs[job].results[0]) {
+        snprintf(buffer, size, "no results");
+    } else {
+        snprintf(buffer, size, "ok");
+    }
+    return buffer;
+}
+
+static void writeCsv(FILE *out) {
+    char status[32];
+    fprintf(out, "run,repeat");
+    for (int i = 0; i < axisCount; i++) {
+        fprintf(out, ",%s", axes[i].name);
+    }
+    fprintf(out, ",status,run_seconds");
+    for (int i = 0; i < resultCount; i++) {
+        fprintf(out, ",%s", resultNames[i]);
+    }
+    fprintf(out, "\n");
+    for (int job = 0; job < jobCount; job++) {
+        fprintf(out, "%d,%d", job, job % repeats);
+        for (int i = 0; i < axisCount; i++) {
+            fprintf(out, ",%s", axisValue(job, i));
+        }
+        fprintf(out, ",%s,%.3f", jobStatus(job, status, sizeof(status)), jobs[job].seconds);
+        for (int i = 0; i < resultCount; i++) {
+            fprintf(out, ",%s", jobs[job].results[i] ? jobs[job].results[i] : "");
+        }
+        fprintf(out, "\n");
+    }
+}
+
+/* A JSON value: numbers as they are, anything else as a string. */
+/* Whether text is a number as JSON spells it, so it can go out unquoted. */
+static int jsonNumber(const char *text) {
+    if (*text == '-') {
+        text++;
+    }
+    if (*text == '0') {
+        text++;
+    } else if (isdigit((unsigned char)*text)) {
+        text += strspn(text, "0123456789");
+    } else {
+        return 0;
+    }
+    if (*text == '.') {
+        if (!isdigit((unsigned char)*++text)) {
+            return 0;
+        }
+        text += strspn(text, "0123456789");
+    }
+    if (*text == 'e' || *text == 'E') {
+        text++;
+        if (*text == '+' || *text == '-') {
+            text++;
+        }
+        if (!isdigit((unsigned char)*text)) {
+            return 0;
+        }
+        text += strspn(text, "0123456789");
+    }
+    return *text == '\0';
+}
+
+/* Numbers as they are; anything else as a string, escaped. */
+static void jsonValue(FILE *out, const char *value) {
+    if (jsonNumber(value)) {
+        fprintf(out, "%s", value);
+        return;
+    }
+    fputc('"', out);
+    for (const unsigned char *c = (const unsigned char *)value; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(out, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(out, "\\u%04x", *c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void writeJson(FILE *out) {
+    char status[32];
+    fprintf(out, "[\n");
+    for (int job = 0; job < jobCount; job++) {
+        fprintf(out, "  {\"run\": %d, \"repeat\": %d", job, job % repeats);
+        for (int i = 0; i < axisCount; i++) {
+            fprintf(out, ", \"%s\": ", axes[i].name);
+            jsonValue(out, axisValue(job, i));
+        }
+        fprintf(out, ", \"status\": \"%s\", \"run_seconds\": %.3f", jobStatus(job, status, sizeof(status)),
+                jobs[job].seconds);
+        for (int i = 0; i < resultCount; i++) {
+            if (jobs[job].results[i]) {
+                fprintf(out, ", \"%s\": ", resultNames[i]);
+                jsonValue(out, jobs[job].results[i]);
+            }
+        }
+        fprintf(out, "}%s\n", job + 1 < jobCount ? "," : "");
+    }
+    fprintf(out, "]\n");
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-j jobs] [-n repeats] [-o results.csv|results.json] [-d dir] [-f grid]\n"
+                    "          name=value[,value...]...\n", prog);
+    fprintf(stderr, "  Run ./oss once for every combination of the given settings (see oss -o),\n");
+    fprintf(stderr, "  several at a time, and collect each run's results into one file.\n");
+    fprintf(stderr, "  -j  runs at once (default: one per CPU)\n");
+    fprintf(stderr, "  -n  run each combination this many times (default 1), repeat r with\n");
+    fprintf(stderr, "      seed=r+1 unless seed is one of the settings\n");
+    fprintf(stderr, "  -o  results file; JSON if it ends in .json, else CSV (default sweep.csv)\n");
+    fprintf(stderr, "  -d  directory for each run's log, stderr and summary (default sweep.out)\n");
+    fprintf(stderr, "  -f  read settings from a file of name = value[,value...] lines\n");
+}
+
+/*
+ * Parameter sweeps. Every run is an independent oss with its own IPC
+ * objects, so runs only compete for CPUs; -j bounds how many there are at
+ * once and the next run starts as soon as one finishes.
+ */
+int main(int argc, char *argv[]) {
+    const char *resultsPath = "sweep.csv";
+    long parallel = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hj:n:o:d:f:")) != -1) {
+        switch (opt) {
+            case 'j':
+                parallel = atoi(optarg);
+                if (parallel <= 0) {
+                    fprintf(stderr, "Error: jobs must be a positive integer.\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'n':
+                repeats = atoi(optarg);
+                if (repeats <= 0) {
+                    fprintf(stderr, "Error: repeats must be a positive integer.\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                resultsPath = optarg;
+                break;
+            case 'd':
+                outDir = optarg;
+                break;
+            case 'f':
+                readGrid(optarg);
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    for (int i = optind; i < argc; i++) {
+        addAxis(argv[i], "argument");
+    }
+    if (parallel <= 0) {
+        parallel = 1;
+    }
+    if (access("./oss", X_OK) == -1 || access("./worker", X_OK) == -1) {
+        fprintf(stderr, "Error: run sweep from the directory holding oss and worker.\n");
+        return EXIT_FAILURE;
+    }
+    if (mkdir(outDir, 0755) == -1 && errno != EEXIST) {
+        perror(outDir);
+        return EXIT_FAILURE;
+    }
+    FILE *out = fopen(resultsPath, "w");
+    if (!out) {
+        perror(resultsPath);
+        return EXIT_FAILURE;
+    }
+
+    jobCount = repeats;
+    for (int i = 0; i < axisCount; i++) {
+        jobCount *= axes[i].count;
+    }
+    jobs = calloc(jobCount, sizeof(Job));
+    if (!jobs) {
+        perror("sweep: out of memory");
+        return EXIT_FAILURE;
+    }
+
+    long long start = nowNanos();
+    int next = 0, running = 0, finished = 0, failed = 0;
+    char status[32];
+    while (finished < jobCount) {
+        while (next < jobCount && running < parallel) {
+            startJob(next++);
+            running++;
+        }
+        int job = reapJob();
+        if (job < 0) {
+            continue;
+        }
+        running--;
+        finished++;
+        readResults(job);
+        if (strcmp(jobStatus(job, status, sizeof(status)), "ok") != 0) {
+            failed++;
+        }
+        fprintf(stderr, "[%d/%d] run %d: %s in %.2f s\n", finished, jobCount, job, status, jobs[job].seconds);
+    }
+
+    if (strlen(resultsPath) > 5 && strcmp(resultsPath + strlen(resultsPath) - 5, ".json") == 0) {
+        writeJson(out);
+    } else {
+        writeCsv(out);
+    }
+    fclose(out);
+    fprintf(stderr, "%d runs (%d failed) in %.2f s, %ld at a time; results in %s\n", jobCount, failed,
+            (nowNanos() - start) / 1e9, parallel, resultsPath);
+    return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
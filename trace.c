@@ -0,0 +1,69 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+TraceFile *traceFile;
+
+static long long monotonicNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int traceOpen(const char *dir, int role, int run, unsigned int capacity) {
+    char path[512];
+    pid_t pid = getpid();
+
+    if (snprintf(path, sizeof(path), "%s/%s.%d.trace", dir, role == TRACE_ROLE_OSS ? "oss" : "worker", (int)pid) >=
+        (int)sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return -1;
+    }
+    size_t bytes = sizeof(TraceHeader) + (size_t)capacity * sizeof(TraceRecord);
+    if (ftruncate(fd, bytes) == -1) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    TraceFile *file = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        return -1;
+    }
+
+    memcpy(file->header.magic, TRACE_MAGIC, sizeof(file->header.magic));
+    file->header.pid = pid;
+    file->header.role = role;
+    file->header.run = run;
+    file->header.capacity = capacity;
+    atomic_store(&file->header.count, 0);
+    file->header.ticksStart = traceTicks();
+    file->header.nanosStart = monotonicNanos();
+    traceFile = file;
+    return 0;
+}
+
+/*
+ * The file stays mapped: another thread may still be recording when oss
+ * shuts down from a signal, and the mapping goes with the process anyway.
+ */
+void traceClose(void) {
+    TraceFile *file = traceFile;
+
+    if (!file) {
+        return;
+    }
+    file->header.ticksEnd = traceTicks();
+    file->header.nanosEnd = monotonicNanos();
+    file->header.closed = 1;
+}
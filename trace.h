@@ -0,0 +1,114 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <time.h>
+
+/*
+ * Optional event tracing (oss -R dir). Every process writes fixed-size
+ * TraceRecords straight into its own file in dir, mapped shared, so
+ * recording an event is one atomic increment and a 32-byte store with no
+ * system call, and the records survive a process that is killed. traceview
+ * merges the files of a run afterwards.
+ *
+ * Each record carries the CPU timestamp counter (or CLOCK_MONOTONIC
+ * nanoseconds where there is none) and the SharedClock time. The header
+ * pairs the counter with CLOCK_MONOTONIC when the file is opened and again
+ * when it is closed, which is how traceview turns counts into nanoseconds.
+ */
+#define TRACE_MAGIC "OSSTRC1"
+
+/* oss */
+#define TRACE_TICK 0
+#define TRACE_TICK_DONE 1
+#define TRACE_LAUNCH 2
+#define TRACE_SEND 3
+#define TRACE_RECEIVE 4
+#define TRACE_TERMINATE 5
+#define TRACE_REAP 6
+#define TRACE_LOST 7
+/* workers, whether processes or fibers */
+#define TRACE_WORKER_START 8
+#define TRACE_WORKER_RECEIVE 9
+#define TRACE_WORKER_SEND 10
+#define TRACE_WORKER_EXIT 11
+#define TRACE_TYPES 12
+
+#define TRACE_ROLE_OSS 0
+#define TRACE_ROLE_WORKER 1
+
+/* Records per file. The files are sparse, so unused room costs nothing. */
+#define TRACE_OSS_RECORDS (1u << 22)
+#define TRACE_WORKER_RECORDS (1u << 16)
+
+typedef struct {
+    unsigned long long ticks;
+    long long clock;
+    int type;
+    int slot;
+    int pid;
+    /* mtext for replies, the number of slots dealt for TRACE_TICK. */
+    int arg;
+} TraceRecord;
+
+typedef struct {
+    char magic[8];
+    int pid;
+    int role;
+    /* The oss pid of the run, so traceview can ignore files left by others. */
+    int run;
+    unsigned int capacity;
+    /* Records claimed; anything past capacity was dropped. */
+    _Atomic unsigned int count;
+    int closed;
+    unsigned long long ticksStart;
+    long long nanosStart;
+    unsigned long long ticksEnd;
+    long long nanosEnd;
+} TraceHeader;
+
+typedef struct {
+    TraceHeader header;
+    TraceRecord records[];
+} TraceFile;
+
+/* This process's trace, or NULL when it isn't tracing. */
+extern TraceFile *traceFile;
+
+static inline unsigned long long traceTicks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/*
+ * Start writing role's trace for run into dir/oss.<pid>.trace or
+ * dir/worker.<pid>.trace. Returns -1 with errno set on failure.
+ */
+int traceOpen(const char *dir, int role, int run, unsigned int capacity);
+
+/* Record the end calibration. Events after this are still kept. */
+void traceClose(void);
+
+static inline void traceEvent(int type, int slot, pid_t pid, int arg, long long clock) {
+    if (!traceFile) {
+        return;
+    }
+    unsigned int index = atomic_fetch_add_explicit(&traceFile->header.count, 1, memory_order_relaxed);
+    if (index < traceFile->header.capacity) {
+        TraceRecord *rec = &traceFile->records[index];
+        rec->ticks = traceTicks();
+        rec->clock = clock;
+        rec->type = type;
+        rec->slot = slot;
+        rec->pid = pid;
+        rec->arg = arg;
+    }
+}
+
+#endif
@@ -0,0 +1,664 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define DEFAULT_LIST 10
+
+static const char *typeNames[TRACE_TYPES] = {"tick", "tick done", "launch", "send", "receive", "terminate",
+                                             "reap", "lost", "start", "worker receive", "worker send", "exit"};
+
+/* A record on the merged timeline; t is wall nanoseconds since oss started tracing. */
+typedef struct {
+    double t;
+    long long clock;
+    int type;
+    int slot;
+    int pid;
+    int arg;
+} Event;
+
+typedef struct {
+    double *items;
+    int count;
+    int capacity;
+} Times;
+
+/* Everything seen for one worker pid, in order. */
+typedef struct {
+    int pid;
+    int slot;
+    double longest;
+    Times sends;
+    Times workerReceives;
+    Times workerSends;
+    Times receives;
+} Worker;
+
+/* One dispatch tick and the round trip that finished last in it. */
+typedef struct {
+    double start;
+    double end;
+    long long clock;
+    int dealt;
+    int critical;
+    int criticalPid;
+    int criticalSlot;
+    double send, workerReceive, workerSend, receive;
+} Tick;
+
+typedef struct {
+    const TraceFile *file;
+    size_t bytes;
+} Loaded;
+
+static Loaded *loaded;
+static int loadedCount;
+static Event *events;
+static long eventCount;
+static Worker *workers;
+static int workerCount;
+static int workerCapacity;
+/* pid to index in workers, open addressing; -1 is empty. */
+static int *workerIndex;
+static int indexMask = -1;
+static Tick *ticks;
+static int tickCount;
+
+static void *grow(void *items, int *capacity, size_t size) {
+    int next = *capacity > 0 ? 2 * *capacity : 64;
+    void *grown = realloc(items, next * size);
+    if (!grown) {
+        perror("traceview: out of memory");
+        exit(EXIT_FAILURE);
+    }
+    *capacity = next;
+    return grown;
+}
+
+static void timesAdd(Times *times, double t) {
+    if (times->count == times->capacity) {
+        times->items = grow(times->items, &times->capacity, sizeof(double));
+    }
+    times->items[times->count++] = t;
+}
+
+static int *indexSlot(int pid) {
+    unsigned int i = (unsigned int)pid * 2654435761u;
+
+    for (i &= indexMask; workerIndex[i] != -1; i = (i + 1) & indexMask) {
+        if (workers[workerIndex[i]].pid == pid) {
+            break;
+        }
+    }
+    return &workerIndex[i];
+}
+
+/* Keep the index at most half full. */
+static void growIndex(void) {
+    int size = indexMask >= 0 ? 2 * (indexMask + 1) : 1024;
+
+    free(workerIndex);
+    workerIndex = malloc(size * sizeof(int));
+    if (!workerIndex) {
+        perror("traceview: out of memory");
+        exit(EXIT_FAILURE);
+    }
+    memset(workerIndex, -1, size * sizeof(int));
+    indexMask = size - 1;
+    for (int i = 0; i < workerCount; i++) {
+        *indexSlot(workers[i].pid) = i;
+    }
+}
+
+static Worker *findWorker(int pid, int slot) {
+    if (2 * (workerCount + 1) > indexMask + 1) {
+        growIndex();
+    }
+    int *index = indexSlot(pid);
+    if (*index != -1) {
+        return &workers[*index];
+    }
+    if (workerCount == workerCapacity) {
+        workers = grow(workers, &workerCapacity, sizeof(Worker));
+    }
+    memset(&workers[workerCount], 0, sizeof(Worker));
+    workers[workerCount].pid = pid;
+    workers[workerCount].slot = slot;
+    *index = workerCount;
+    return &workers[workerCount++];
+}
+
+static int byTime(const void *a, const void *b) {
+    double x = ((const Event *)a)->t, y = ((const Event *)b)->t;
+    return x < y ? -1 : x > y;
+}
+
+static int byValue(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int byDuration(const void *a, const void *b) {
+    double x = ((const Tick *)a)->end - ((const Tick *)a)->start;
+    double y = ((const Tick *)b)->end - ((const Tick *)b)->start;
+    return x > y ? -1 : x < y;
+}
+
+static double maxRoundTrip(const Worker *worker) {
+    double longest = 0;
+    int trips = worker->receives.count < worker->sends.count ? worker->receives.count : worker->sends.count;
+
+    for (int i = 0; i < trips; i++) {
+        if (worker->receives.items[i] - worker->sends.items[i] > longest) {
+            longest = worker->receives.items[i] - worker->sends.items[i];
+        }
+    }
+    return longest;
+}
+
+static int bySlowest(const void *a, const void *b) {
+    double x = ((const Worker *)a)->longest, y = ((const Worker *)b)->longest;
+    return x > y ? -1 : x < y;
+}
+
+/* Round trips of a worker that show up on both sides. */
+static int tripCount(const Worker *worker) {
+    int trips = worker->sends.count;
+
+    if (worker->workerReceives.count < trips) {
+        trips = worker->workerReceives.count;
+    }
+    if (worker->workerSends.count < trips) {
+        trips = worker->workerSends.count;
+    }
+    if (worker->receives.count < trips) {
+        trips = worker->receives.count;
+    }
+    return trips;
+}
+
+static const TraceFile *loadFile(const char *path, size_t *bytes) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+
+    if (fd == -1) {
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(TraceHeader)) {
+        close(fd);
+        return NULL;
+    }
+    const TraceFile *file = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        return NULL;
+    }
+    if (memcmp(file->header.magic, TRACE_MAGIC, sizeof(file->header.magic)) != 0 ||
+        sizeof(TraceHeader) + (size_t)file->header.capacity * sizeof(TraceRecord) > (size_t)st.st_size) {
+        munmap((void *)file, st.st_size);
+        return NULL;
+    }
+    *bytes = st.st_size;
+    return file;
+}
+
+static void loadDirectory(const char *dir) {
+    DIR *d = opendir(dir);
+    struct dirent *entry;
+    int capacity = 0;
+    char path[4096];
+
+    if (!d) {
+        perror("opendir failed");
+        exit(EXIT_FAILURE);
+    }
+    while ((entry = readdir(d)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        if (length < 6 || strcmp(entry->d_name + length - 6, ".trace") != 0) {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        size_t bytes;
+        const TraceFile *file = loadFile(path, &bytes);
+        if (!file) {
+            fprintf(stderr, "traceview: skipping %s: not a trace file\n", path);
+            continue;
+        }
+        if (loadedCount == capacity) {
+            loaded = grow(loaded, &capacity, sizeof(Loaded));
+        }
+        loaded[loadedCount].file = file;
+        loaded[loadedCount].bytes = bytes;
+        loadedCount++;
+    }
+    closedir(d);
+}
+
+static unsigned int recordsIn(const TraceFile *file) {
+    unsigned int count = atomic_load((_Atomic unsigned int *)&file->header.count);
+    return count < file->header.capacity ? count : file->header.capacity;
+}
+
+/*
+ * Merge every file of the newest run onto one timeline. The timestamp
+ * counter is shared by all CPUs, so one conversion fits every file: oss's
+ * own calibration if it closed cleanly, else that of any worker that did.
+ */
+static const TraceFile *mergeRun(unsigned long *dropped, int *files) {
+    const TraceFile *oss = NULL;
+
+    for (int i = 0; i < loadedCount; i++) {
+        const TraceFile *file = loaded[i].file;
+        if (file->header.role == TRACE_ROLE_OSS && (!oss || file->header.nanosStart > oss->header.nanosStart)) {
+            oss = file;
+        }
+    }
+    if (!oss) {
+        return NULL;
+    }
+
+    double nanosPerTick = 1.0;
+    for (int i = -1; i < loadedCount; i++) {
+        const TraceFile *file = i < 0 ? oss : loaded[i].file;
+        if (file->header.run == oss->header.pid && file->header.closed &&
+            file->header.ticksEnd > file->header.ticksStart + 1000000) {
+            nanosPerTick = (double)(file->header.nanosEnd - file->header.nanosStart) /
+                           (double)(file->header.ticksEnd - file->header.ticksStart);
+            break;
+        }
+    }
+
+    long total = 0;
+    for (int i = 0; i < loadedCount; i++) {
+        if (loaded[i].file->header.run == oss->header.pid) {
+            total += recordsIn(loaded[i].file);
+        }
+    }
+    events = malloc((total > 0 ? total : 1) * sizeof(Event));
+    if (!events) {
+        perror("traceview: out of memory");
+        exit(EXIT_FAILURE);
+    }
+    *dropped = 0;
+    *files = 0;
+    for (int i = 0; i < loadedCount; i++) {
+        const TraceFile *file = loaded[i].file;
+        if (file->header.run != oss->header.pid) {
+            continue;
+        }
+        unsigned int count = recordsIn(file);
+        (*files)++;
+        *dropped += atomic_load((_Atomic unsigned int *)&file->header.count) - count;
+        for (unsigned int j = 0; j < count; j++) {
+            const TraceRecord *rec = &file->records[j];
+            if (rec->type < 0 || rec->type >= TRACE_TYPES) {
+                continue;
+            }
+            Event *event = &events[eventCount++];
+            event->t = ((double)rec->ticks - (double)oss->header.ticksStart) * nanosPerTick;
+            event->clock = rec->clock;
+            event->type = rec->type;
+            event->slot = rec->slot;
+            event->pid = rec->pid;
+            event->arg = rec->arg;
+        }
+    }
+    qsort(events, eventCount, sizeof(Event), byTime);
+    return oss;
+}
+
+/* Sort out the merged events by worker and by tick. */
+static void sortEvents(void) {
+    int tickCapacity = 0;
+
+    for (long i = 0; i < eventCount; i++) {
+        Event *event = &events[i];
+        switch (event->type) {
+            case TRACE_TICK:
+                if (tickCount == tickCapacity) {
+                    ticks = grow(ticks, &tickCapacity, sizeof(Tick));
+                }
+                memset(&ticks[tickCount], 0, sizeof(Tick));
+                ticks[tickCount].start = ticks[tickCount].end = event->t;
+                ticks[tickCount].clock = event->clock;
+                ticks[tickCount].dealt = event->arg;
+                tickCount++;
+                break;
+            case TRACE_TICK_DONE:
+                if (tickCount > 0) {
+                    ticks[tickCount - 1].end = event->t;
+                }
+                break;
+            case TRACE_SEND:
+                timesAdd(&findWorker(event->pid, event->slot)->sends, event->t);
+                break;
+            case TRACE_WORKER_RECEIVE:
+                timesAdd(&findWorker(event->pid, event->slot)->workerReceives, event->t);
+                break;
+            case TRACE_WORKER_SEND:
+                timesAdd(&findWorker(event->pid, event->slot)->workerSends, event->t);
+                break;
+            case TRACE_RECEIVE:
+                timesAdd(&findWorker(event->pid, event->slot)->receives, event->t);
+                break;
+        }
+    }
+}
+
+/* The tick a send at time t went out in, or -1. */
+static int tickAt(double t) {
+    int low = 0, high = tickCount - 1, found = -1;
+
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (ticks[mid].start <= t) {
+            found = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return found >= 0 && t <= ticks[found].end ? found : -1;
+}
+
+static void findCriticalPaths(void) {
+    for (int w = 0; w < workerCount; w++) {
+        Worker *worker = &workers[w];
+        int trips = tripCount(worker);
+        for (int i = 0; i < trips; i++) {
+            int k = tickAt(worker->sends.items[i]);
+            if (k < 0 || (ticks[k].critical && ticks[k].receive >= worker->receives.items[i])) {
+                continue;
+            }
+            ticks[k].critical = 1;
+            ticks[k].criticalPid = worker->pid;
+            ticks[k].criticalSlot = worker->slot;
+            ticks[k].send = worker->sends.items[i];
+            ticks[k].workerReceive = worker->workerReceives.items[i];
+            ticks[k].workerSend = worker->workerSends.items[i];
+            ticks[k].receive = worker->receives.items[i];
+        }
+    }
+}
+
+static void printDistribution(const char *name, Times *times) {
+    if (times->count == 0) {
+        return;
+    }
+    double total = 0;
+    for (int i = 0; i < times->count; i++) {
+        total += times->items[i];
+    }
+    qsort(times->items, times->count, sizeof(double), byValue);
+    printf("  %-12s %10.1f %10.1f %10.1f %10.1f\n", name, total / times->count / 1000.0,
+           times->items[times->count / 2] / 1000.0, times->items[(int)(times->count * 0.99)] / 1000.0,
+           times->items[times->count - 1] / 1000.0);
+}
+
+static void reportRoundTrips(void) {
+    Times delivery = {0}, service = {0}, replyWait = {0}, roundTrip = {0};
+
+    for (int w = 0; w < workerCount; w++) {
+        Worker *worker = &workers[w];
+        int trips = tripCount(worker);
+        for (int i = 0; i < trips; i++) {
+            timesAdd(&delivery, worker->workerReceives.items[i] - worker->sends.items[i]);
+            timesAdd(&service, worker->workerSends.items[i] - worker->workerReceives.items[i]);
+            timesAdd(&replyWait, worker->receives.items[i] - worker->workerSends.items[i]);
+            timesAdd(&roundTrip, worker->receives.items[i] - worker->sends.items[i]);
+        }
+    }
+    printf("\n%d round trips over %d workers\n", roundTrip.count, workerCount);
+    printf("  %-12s %10s %10s %10s %10s\n", "(us)", "mean", "p50", "p99", "max");
+    printDistribution("delivery", &delivery);
+    printDistribution("service", &service);
+    printDistribution("reply wait", &replyWait);
+    printDistribution("round trip", &roundTrip);
+    free(delivery.items);
+    free(service.items);
+    free(replyWait.items);
+    free(roundTrip.items);
+}
+
+/* Launch to the worker's first event, matched by slot. */
+static void reportLaunches(void) {
+    Times latency = {0};
+    int slots = 0;
+
+    for (long i = 0; i < eventCount; i++) {
+        if (events[i].slot >= slots) {
+            slots = events[i].slot + 1;
+        }
+    }
+    double *launchedAt = calloc(slots > 0 ? slots : 1, sizeof(double));
+    char *pending = calloc(slots > 0 ? slots : 1, 1);
+    for (long i = 0; i < eventCount; i++) {
+        Event *event = &events[i];
+        if (event->slot < 0) {
+            continue;
+        }
+        if (event->type == TRACE_LAUNCH) {
+            launchedAt[event->slot] = event->t;
+            pending[event->slot] = 1;
+        } else if (event->type == TRACE_WORKER_START && pending[event->slot]) {
+            timesAdd(&latency, event->t - launchedAt[event->slot]);
+            pending[event->slot] = 0;
+        }
+    }
+    if (latency.count > 0) {
+        printf("\n%d launches, launch to worker start\n", latency.count);
+        printf("  %-12s %10s %10s %10s %10s\n", "(us)", "mean", "p50", "p99", "max");
+        printDistribution("start", &latency);
+    }
+    free(latency.items);
+    free(launchedAt);
+    free(pending);
+}
+
+static void reportTicks(int list) {
+    double total = 0, lead = 0, delivery = 0, service = 0, replyWait = 0, tail = 0;
+    int critical = 0;
+
+    if (tickCount == 0) {
+        return;
+    }
+    for (int k = 0; k < tickCount; k++) {
+        Tick *tick = &ticks[k];
+        total += tick->end - tick->start;
+        if (tick->critical) {
+            critical++;
+            lead += tick->send - tick->start;
+            delivery += tick->workerReceive - tick->send;
+            service += tick->workerSend - tick->workerReceive;
+            replyWait += tick->receive - tick->workerSend;
+            tail += tick->end - tick->receive;
+        }
+    }
+    printf("\n%d ticks, mean dispatch %.1f us\n", tickCount, total / tickCount / 1000.0);
+    if (critical > 0) {
+        printf("critical path of a tick on average (us): lead-in %.1f, delivery %.1f, service %.1f, "
+               "reply wait %.1f, tail %.1f\n",
+               lead / critical / 1000.0, delivery / critical / 1000.0, service / critical / 1000.0,
+               replyWait / critical / 1000.0, tail / critical / 1000.0);
+    }
+
+    Tick *sorted = malloc(tickCount * sizeof(Tick));
+    memcpy(sorted, ticks, tickCount * sizeof(Tick));
+    qsort(sorted, tickCount, sizeof(Tick), byDuration);
+    printf("slowest ticks:\n");
+    printf("  %12s %10s %6s %8s %5s %9s %9s %9s %9s %9s\n", "clock", "dur-us", "dealt", "pid", "slot", "lead-in",
+           "delivery", "service", "reply", "tail");
+    for (int k = 0; k < tickCount && k < list; k++) {
+        Tick *tick = &sorted[k];
+        printf("  %2lld.%09lld %10.1f %6d", tick->clock / 1000000000LL, tick->clock % 1000000000LL,
+               (tick->end - tick->start) / 1000.0, tick->dealt);
+        if (tick->critical) {
+            printf(" %8d %5d %9.1f %9.1f %9.1f %9.1f %9.1f\n", tick->criticalPid, tick->criticalSlot,
+                   (tick->send - tick->start) / 1000.0, (tick->workerReceive - tick->send) / 1000.0,
+                   (tick->workerSend - tick->workerReceive) / 1000.0, (tick->receive - tick->workerSend) / 1000.0,
+                   (tick->end - tick->receive) / 1000.0);
+        } else {
+            printf(" %8s\n", "-");
+        }
+    }
+    free(sorted);
+}
+
+static void reportWorkers(int list) {
+    Worker *sorted = malloc((workerCount > 0 ? workerCount : 1) * sizeof(Worker));
+
+    for (int w = 0; w < workerCount; w++) {
+        workers[w].longest = maxRoundTrip(&workers[w]);
+    }
+    memcpy(sorted, workers, workerCount * sizeof(Worker));
+    qsort(sorted, workerCount, sizeof(Worker), bySlowest);
+    if (list < workerCount) {
+        printf("\nworkers, %d slowest by longest round trip:\n", list);
+    } else {
+        printf("\nworkers:\n");
+    }
+    printf("  %8s %5s %7s %11s %11s %11s %11s %11s\n", "pid", "slot", "trips", "deliver-us", "service-us", "reply-us",
+           "rtt-us", "maxrtt-us");
+    for (int w = 0; w < workerCount && w < list; w++) {
+        Worker *worker = &sorted[w];
+        int trips = tripCount(worker);
+        double delivery = 0, service = 0, replyWait = 0;
+        for (int i = 0; i < trips; i++) {
+            delivery += worker->workerReceives.items[i] - worker->sends.items[i];
+            service += worker->workerSends.items[i] - worker->workerReceives.items[i];
+            replyWait += worker->receives.items[i] - worker->workerSends.items[i];
+        }
+        double per = trips > 0 ? trips * 1000.0 : 1.0;
+        printf("  %8d %5d %7d %11.1f %11.1f %11.1f %11.1f %11.1f\n", worker->pid, worker->slot, trips,
+               delivery / per, service / per, replyWait / per, (delivery + service + replyWait) / per,
+               worker->longest / 1000.0);
+    }
+    free(sorted);
+}
+
+/*
+ * Chrome trace event format (chrome://tracing, Perfetto): oss's ticks on
+ * its own row, each slot's round trips on a row of their own under oss, and
+ * each worker's time between receiving a tick and answering it under the
+ * worker.
+ */
+static int exportChrome(const char *path, int ossPid) {
+    FILE *out = fopen(path, "w");
+
+    if (!out) {
+        return -1;
+    }
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"oss\"}}", ossPid);
+    for (int k = 0; k < tickCount; k++) {
+        fprintf(out, ",\n{\"name\":\"tick\",\"ph\":\"X\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,"
+                     "\"args\":{\"clock\":%lld,\"dealt\":%d}}",
+                ossPid, ticks[k].start / 1000.0, (ticks[k].end - ticks[k].start) / 1000.0, ticks[k].clock,
+                ticks[k].dealt);
+    }
+    for (int w = 0; w < workerCount; w++) {
+        Worker *worker = &workers[w];
+        int trips = tripCount(worker);
+        fprintf(out, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"worker %d\"}}",
+                worker->pid, worker->pid);
+        for (int i = 0; i < trips; i++) {
+            fprintf(out, ",\n{\"name\":\"round trip\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                         "\"args\":{\"worker\":%d}}",
+                    ossPid, worker->slot + 1, worker->sends.items[i] / 1000.0,
+                    (worker->receives.items[i] - worker->sends.items[i]) / 1000.0, worker->pid);
+            fprintf(out, ",\n{\"name\":\"service\",\"ph\":\"X\",\"pid\":%d,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+                    worker->pid, worker->workerReceives.items[i] / 1000.0,
+                    (worker->workerSends.items[i] - worker->workerReceives.items[i]) / 1000.0);
+        }
+    }
+    for (long i = 0; i < eventCount; i++) {
+        Event *event = &events[i];
+        if (event->type == TRACE_LAUNCH || event->type == TRACE_TERMINATE || event->type == TRACE_REAP ||
+            event->type == TRACE_LOST) {
+            fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,"
+                         "\"args\":{\"pid\":%d,\"clock\":%lld}}",
+                    typeNames[event->type], ossPid, event->slot + 1, event->t / 1000.0, event->pid, event->clock);
+        }
+    }
+    fprintf(out, "\n]}\n");
+    return fclose(out);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-j out.json] [-n count] [-a] dir\n", prog);
+    fprintf(stderr, "  Merge the trace files oss -R wrote into dir and report round-trip latency,\n");
+    fprintf(stderr, "  where it goes, and what held up the slowest ticks.\n");
+    fprintf(stderr, "  -j  also write the timeline in Chrome trace format\n");
+    fprintf(stderr, "  -n  how many of the slowest ticks and workers to list (default %d)\n", DEFAULT_LIST);
+    fprintf(stderr, "  -a  list every worker\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *jsonPath = NULL;
+    int list = DEFAULT_LIST;
+    int all = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hj:n:a")) != -1) {
+        switch (opt) {
+            case 'j':
+                jsonPath = optarg;
+                break;
+            case 'n':
+                list = atoi(optarg);
+                if (list < 0) {
+                    fprintf(stderr, "Error: count must be non-negative.\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'a':
+                all = 1;
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    loadDirectory(argv[optind]);
+    unsigned long dropped;
+    int files;
+    const TraceFile *oss = mergeRun(&dropped, &files);
+    if (!oss) {
+        fprintf(stderr, "Error: no oss trace in %s.\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    sortEvents();
+    findCriticalPaths();
+
+    printf("run of oss %d: %d trace files, %ld events", oss->header.pid, files, eventCount);
+    if (dropped > 0) {
+        printf(", %lu dropped when buffers filled", dropped);
+    }
+    printf(", %.3f s wall\n", eventCount > 0 ? (events[eventCount - 1].t - events[0].t) / 1e9 : 0.0);
+    reportRoundTrips();
+    reportLaunches();
+    reportTicks(list);
+    reportWorkers(all ? workerCount : list);
+
+    if (jsonPath) {
+        if (exportChrome(jsonPath, oss->header.pid) != 0) {
+            perror("writing Chrome trace failed");
+            return EXIT_FAILURE;
+        }
+        printf("\nChrome trace written to %s\n", jsonPath);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,530 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <mqueue.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "transport.h"
+
+#define MSG_SIZE (sizeof(struct msgbuf) - sizeof(long))
+
+/* Queue depth for the per-slot POSIX queues; a slot never has more than a couple of messages in flight. */
+#define MQ_DEPTH 4
+
+static SharedSegment *segment;
+static int capacity;
+
+static void napMicros(long micros) {
+    struct timespec nap = {0, micros * 1000};
+    nanosleep(&nap, NULL);
+}
+
+/* SysV: one queue for everyone, addressed by mtype. */
+
+static int msqid = -1;
+
+static int sysvOpen(SharedSegment *seg, int cap) {
+    msqid = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+    seg->msqid = msqid;
+    return msqid == -1 ? -1 : 0;
+}
+
+static void sysvClose(void) {
+    if (msqid != -1) {
+        msgctl(msqid, IPC_RMID, NULL);
+    }
+}
+
+static void sysvPrepare(int slot) {
+}
+
+static int sysvSend(int slot, const struct msgbuf *msg) {
+    return msgsnd(msqid, msg, MSG_SIZE, 0);
+}
+
+static int sysvPoll(int slot, pid_t pid, struct msgbuf *msg) {
+    if (msgrcv(msqid, msg, MSG_SIZE, pid, IPC_NOWAIT) != -1) {
+        return 1;
+    }
+    return errno == ENOMSG ? 0 : -1;
+}
+
+static int sysvPollAny(struct msgbuf *msg, int block) {
+    if (msgrcv(msqid, msg, MSG_SIZE, ANY_REPLY_TYPE, block ? 0 : IPC_NOWAIT) != -1) {
+        return 1;
+    }
+    return errno == ENOMSG ? 0 : -1;
+}
+
+static int sysvAttach(SharedSegment *seg, int slot) {
+    if (seg->msqid == -1) {
+        errno = ENOENT;
+        return -1;
+    }
+    msqid = seg->msqid;
+    return 0;
+}
+
+static int sysvReceive(int slot, pid_t self, struct msgbuf *msg) {
+    return msgrcv(msqid, msg, MSG_SIZE, toWorkerType(self), 0) == -1 ? -1 : 0;
+}
+
+static int sysvReply(int slot, const struct msgbuf *msg) {
+    return msgsnd(msqid, msg, MSG_SIZE, 0);
+}
+
+/* Shared-memory rings, polled (ring) or with futex wakeups (futex). */
+
+static int ringOpen(SharedSegment *seg, int cap) {
+    segment = seg;
+    capacity = cap;
+    return 0;
+}
+
+static void ringClose(void) {
+}
+
+static void ringPrepare(int slot) {
+    ringReset(&segment->slots[slot].toWorker);
+    ringReset(&segment->slots[slot].toOss);
+}
+
+static int ringTransportSend(int slot, const struct msgbuf *msg) {
+    ringSend(&segment->slots[slot].toWorker, msg);
+    return 0;
+}
+
+static int ringPoll(int slot, pid_t pid, struct msgbuf *msg) {
+    return ringPop(&segment->slots[slot].toOss, msg);
+}
+
+static int ringAttach(SharedSegment *seg, int slot) {
+    segment = seg;
+    return 0;
+}
+
+static int ringTransportReceive(int slot, pid_t self, struct msgbuf *msg) {
+    ringReceive(&segment->slots[slot].toWorker, msg);
+    return 0;
+}
+
+static int ringReply(int slot, const struct msgbuf *msg) {
+    ringSend(&segment->slots[slot].toOss, msg);
+    return 0;
+}
+
+static int futexSend(int slot, const struct msgbuf *msg) {
+    ringSendWake(&segment->slots[slot].toWorker, msg);
+    return 0;
+}
+
+static unsigned int futexArm(void) {
+    return bellRead(segment);
+}
+
+static void futexWaitReply(unsigned int token, long timeoutNanos) {
+    bellWait(segment, token, timeoutNanos);
+}
+
+static int futexReceive(int slot, pid_t self, struct msgbuf *msg) {
+    ringReceiveWait(&segment->slots[slot].toWorker, msg);
+    return 0;
+}
+
+static int futexReply(int slot, const struct msgbuf *msg) {
+    ringSend(&segment->slots[slot].toOss, msg);
+    bellRing(segment);
+    return 0;
+}
+
+/*
+ * MPSC: ticks go out on each slot's ring as with futex, but every reply
+ * comes back through the segment's one ReplyQueue. pollAny takes replies
+ * straight off the queue; a per-slot poll drains everything queued into
+ * per-slot mailboxes and looks in its own. With dispatcher threads,
+ * whichever thread gets the drain flag empties the queue for all of them
+ * and rings the bell for any that went to sleep waiting.
+ */
+
+typedef struct {
+    _Atomic int full;
+    /* On the filled list, so pollAny will look here. */
+    int listed;
+    struct msgbuf msg;
+} Mailbox;
+
+static ReplyQueue *replies;
+static Mailbox *mailboxes;
+static int *filled;
+static int filledHead, filledCount;
+static atomic_flag draining = ATOMIC_FLAG_INIT;
+
+static int mpscOpen(SharedSegment *seg, int cap) {
+    segment = seg;
+    capacity = cap;
+    replies = segmentReplies(seg);
+    replyQueueInit(replies, cap);
+    mailboxes = calloc(cap, sizeof(Mailbox));
+    filled = malloc(cap * sizeof(int));
+    filledHead = filledCount = 0;
+    return mailboxes && filled ? 0 : -1;
+}
+
+static void mpscClose(void) {
+    free(mailboxes);
+    free(filled);
+    mailboxes = NULL;
+    filled = NULL;
+}
+
+/* A stale reply from the slot's last worker could still be queued; poll throws it away by pid. */
+static void mpscPrepare(int slot) {
+    ringReset(&segment->slots[slot].toWorker);
+    atomic_store(&mailboxes[slot].full, 0);
+}
+
+/* Move every queued reply into its slot's mailbox. Call with draining held. */
+static void mpscDrain(void) {
+    struct msgbuf msg;
+    int slot, moved = 0;
+
+    while (replyPop(replies, &slot, &msg)) {
+        if (slot < 0 || slot >= capacity) {
+            continue;
+        }
+        mailboxes[slot].msg = msg;
+        atomic_store_explicit(&mailboxes[slot].full, 1, memory_order_release);
+        if (!mailboxes[slot].listed) {
+            mailboxes[slot].listed = 1;
+            filled[(filledHead + filledCount) % capacity] = slot;
+            filledCount++;
+        }
+        moved++;
+    }
+    if (moved > 0 && atomic_load(&segment->bellSleepers) > 0) {
+        bellRing(segment);
+    }
+}
+
+static int mailboxTake(int slot, pid_t pid, struct msgbuf *msg) {
+    if (!atomic_load_explicit(&mailboxes[slot].full, memory_order_acquire)) {
+        return 0;
+    }
+    *msg = mailboxes[slot].msg;
+    atomic_store(&mailboxes[slot].full, 0);
+    return pid == 0 || msg->mtype == pid;
+}
+
+static int mpscPoll(int slot, pid_t pid, struct msgbuf *msg) {
+    if (mailboxTake(slot, pid, msg)) {
+        return 1;
+    }
+    if (atomic_flag_test_and_set(&draining)) {
+        return 0;
+    }
+    mpscDrain();
+    atomic_flag_clear(&draining);
+    return mailboxTake(slot, pid, msg);
+}
+
+static int mpscPollAny(struct msgbuf *msg, int block) {
+    for (;;) {
+        unsigned int token = bellRead(segment);
+        if (!atomic_flag_test_and_set(&draining)) {
+            int got = 0, slot;
+            while (!got && filledCount > 0) {
+                slot = filled[filledHead];
+                filledHead = (filledHead + 1) % capacity;
+                filledCount--;
+                mailboxes[slot].listed = 0;
+                got = mailboxTake(slot, 0, msg);
+            }
+            if (!got) {
+                got = replyPop(replies, &slot, msg);
+            }
+            atomic_flag_clear(&draining);
+            if (got) {
+                return 1;
+            }
+        }
+        if (!block) {
+            return 0;
+        }
+        bellWait(segment, token, 0);
+    }
+}
+
+static int mpscAttach(SharedSegment *seg, int slot) {
+    segment = seg;
+    replies = segmentReplies(seg);
+    return 0;
+}
+
+static int mpscReply(int slot, const struct msgbuf *msg) {
+    if (replyPush(replies, slot, msg)) {
+        bellRing(segment);
+    }
+    return 0;
+}
+
+/*
+ * Wait for any of the descriptors to become readable. Both the POSIX queue
+ * and socket backends can be polled, so oss sleeps in the kernel until a
+ * reply lands rather than napping.
+ */
+static struct pollfd *pollSet;
+
+static void waitReadable(unsigned int token, long timeoutNanos) {
+    int millis = -1;
+    if (timeoutNanos > 0) {
+        millis = timeoutNanos < 1000000 ? 1 : timeoutNanos / 1000000;
+    }
+    poll(pollSet, capacity, millis);
+}
+
+static unsigned int noToken(void) {
+    return 0;
+}
+
+/*
+ * POSIX message queues: two per slot, named after the oss pid so runs don't
+ * collide. oss holds both ends non-blocking; the worker opens its ends
+ * blocking. The system-wide queues_max (256 by default) caps capacity.
+ */
+
+static mqd_t *toWorkerQueues;
+static mqd_t *toOssQueues;
+static pid_t queueOwner;
+static mqd_t workerIn = (mqd_t)-1, workerOut = (mqd_t)-1;
+
+static void mqName(char *name, size_t size, pid_t owner, int slot, const char *direction) {
+    snprintf(name, size, "/oss.%d.%d.%s", (int)owner, slot, direction);
+}
+
+static void mqClose(void) {
+    char name[64];
+
+    for (int i = 0; toWorkerQueues && i < capacity; i++) {
+        if (toWorkerQueues[i] != (mqd_t)-1) {
+            mq_close(toWorkerQueues[i]);
+            mqName(name, sizeof(name), queueOwner, i, "in");
+            mq_unlink(name);
+        }
+        if (toOssQueues[i] != (mqd_t)-1) {
+            mq_close(toOssQueues[i]);
+            mqName(name, sizeof(name), queueOwner, i, "out");
+            mq_unlink(name);
+        }
+    }
+}
+
+static int mqOpen(SharedSegment *seg, int cap) {
+    struct mq_attr attr = {0, MQ_DEPTH, sizeof(struct msgbuf), 0};
+    char name[64];
+
+    queueOwner = seg->ossPid;
+    capacity = cap;
+    toWorkerQueues = malloc(cap * sizeof(mqd_t));
+    toOssQueues = malloc(cap * sizeof(mqd_t));
+    pollSet = calloc(cap, sizeof(struct pollfd));
+    if (!toWorkerQueues || !toOssQueues || !pollSet) {
+        return -1;
+    }
+    for (int i = 0; i < cap; i++) {
+        toWorkerQueues[i] = toOssQueues[i] = (mqd_t)-1;
+    }
+    for (int i = 0; i < cap; i++) {
+        mqName(name, sizeof(name), queueOwner, i, "in");
+        toWorkerQueues[i] = mq_open(name, O_CREAT | O_RDWR | O_NONBLOCK | O_CLOEXEC, 0600, &attr);
+        mqName(name, sizeof(name), queueOwner, i, "out");
+        toOssQueues[i] = mq_open(name, O_CREAT | O_RDWR | O_NONBLOCK | O_CLOEXEC, 0600, &attr);
+        if (toWorkerQueues[i] == (mqd_t)-1 || toOssQueues[i] == (mqd_t)-1) {
+            return -1;
+        }
+        pollSet[i].fd = toOssQueues[i];
+        pollSet[i].events = POLLIN;
+    }
+    return 0;
+}
+
+/* Throw away anything a previous worker in the slot left behind. */
+static void mqPrepare(int slot) {
+    struct msgbuf msg;
+    while (mq_receive(toWorkerQueues[slot], (char *)&msg, sizeof(msg), NULL) != -1) {
+    }
+    while (mq_receive(toOssQueues[slot], (char *)&msg, sizeof(msg), NULL) != -1) {
+    }
+}
+
+static int mqSend(int slot, const struct msgbuf *msg) {
+    while (mq_send(toWorkerQueues[slot], (const char *)msg, sizeof(*msg), 0) == -1) {
+        if (errno != EAGAIN) {
+            return -1;
+        }
+        napMicros(50);
+    }
+    return 0;
+}
+
+static int mqPoll(int slot, pid_t pid, struct msgbuf *msg) {
+    if (mq_receive(toOssQueues[slot], (char *)msg, sizeof(*msg), NULL) != -1) {
+        return 1;
+    }
+    return errno == EAGAIN ? 0 : -1;
+}
+
+static int mqAttach(SharedSegment *seg, int slot) {
+    char name[64];
+
+    mqName(name, sizeof(name), seg->ossPid, slot, "in");
+    workerIn = mq_open(name, O_RDONLY);
+    mqName(name, sizeof(name), seg->ossPid, slot, "out");
+    workerOut = mq_open(name, O_WRONLY);
+    return workerIn == (mqd_t)-1 || workerOut == (mqd_t)-1 ? -1 : 0;
+}
+
+static int mqReceive(int slot, pid_t self, struct msgbuf *msg) {
+    return mq_receive(workerIn, (char *)msg, sizeof(*msg), NULL) == -1 ? -1 : 0;
+}
+
+static int mqReply(int slot, const struct msgbuf *msg) {
+    return mq_send(workerOut, (const char *)msg, sizeof(*msg), 0);
+}
+
+/*
+ * AF_UNIX SOCK_SEQPACKET: a fresh socketpair per worker. oss keeps its end
+ * non-blocking and the worker's end is handed down at TRANSPORT_FD.
+ */
+
+static int *ossEnds;
+static int *workerEnds;
+
+static int socketOpen(SharedSegment *seg, int cap) {
+    capacity = cap;
+    ossEnds = malloc(cap * sizeof(int));
+    workerEnds = malloc(cap * sizeof(int));
+    pollSet = calloc(cap, sizeof(struct pollfd));
+    if (!ossEnds || !workerEnds || !pollSet) {
+        return -1;
+    }
+    for (int i = 0; i < cap; i++) {
+        ossEnds[i] = workerEnds[i] = -1;
+        pollSet[i].fd = -1;
+        pollSet[i].events = POLLIN;
+    }
+    return 0;
+}
+
+static void socketClose(void) {
+    for (int i = 0; ossEnds && i < capacity; i++) {
+        if (ossEnds[i] != -1) {
+            close(ossEnds[i]);
+            close(workerEnds[i]);
+        }
+    }
+}
+
+static void socketPrepare(int slot) {
+    int ends[2];
+
+    if (ossEnds[slot] != -1) {
+        close(ossEnds[slot]);
+        close(workerEnds[slot]);
+    }
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, ends) == -1) {
+        perror("socketpair failed");
+        exit(EXIT_FAILURE);
+    }
+    fcntl(ends[0], F_SETFL, O_NONBLOCK);
+    ossEnds[slot] = pollSet[slot].fd = ends[0];
+    workerEnds[slot] = ends[1];
+}
+
+static void socketInherit(int slot) {
+    if (workerEnds[slot] == TRANSPORT_FD) {
+        fcntl(TRANSPORT_FD, F_SETFD, 0);
+    } else {
+        dup2(workerEnds[slot], TRANSPORT_FD);
+    }
+}
+
+static int socketSend(int slot, const struct msgbuf *msg) {
+    while (send(ossEnds[slot], msg, sizeof(*msg), MSG_NOSIGNAL) == -1) {
+        if (errno != EAGAIN) {
+            return -1;
+        }
+        napMicros(50);
+    }
+    return 0;
+}
+
+static int socketPoll(int slot, pid_t pid, struct msgbuf *msg) {
+    ssize_t n = recv(ossEnds[slot], msg, sizeof(*msg), MSG_DONTWAIT);
+    if (n == sizeof(*msg)) {
+        return 1;
+    }
+    /* 0 is the worker hanging up; oss learns about that from SIGCHLD. */
+    return n == -1 && errno != EAGAIN ? -1 : 0;
+}
+
+static int socketAttach(SharedSegment *seg, int slot) {
+    return fcntl(TRANSPORT_FD, F_GETFD) == -1 ? -1 : 0;
+}
+
+static int socketReceive(int slot, pid_t self, struct msgbuf *msg) {
+    ssize_t n = recv(TRANSPORT_FD, msg, sizeof(*msg), 0);
+    if (n == 0) {
+        errno = EPIPE;
+    }
+    return n == sizeof(*msg) ? 0 : -1;
+}
+
+static int socketReply(int slot, const struct msgbuf *msg) {
+    return send(TRANSPORT_FD, msg, sizeof(*msg), MSG_NOSIGNAL) == -1 ? -1 : 0;
+}
+
+static const Transport transports[] = {
+    {"sysv", TRANSPORT_SYSV, sysvOpen, sysvClose, sysvPrepare, NULL, sysvSend, sysvPoll, sysvPollAny,
+     NULL, NULL, sysvAttach, sysvReceive, sysvReply},
+    {"ring", TRANSPORT_RING, ringOpen, ringClose, ringPrepare, NULL, ringTransportSend, ringPoll, NULL,
+     NULL, NULL, ringAttach, ringTransportReceive, ringReply},
+    {"futex", TRANSPORT_FUTEX, ringOpen, ringClose, ringPrepare, NULL, futexSend, ringPoll, NULL,
+     futexArm, futexWaitReply, ringAttach, futexReceive, futexReply},
+    {"mqueue", TRANSPORT_MQUEUE, mqOpen, mqClose, mqPrepare, NULL, mqSend, mqPoll, NULL,
+     noToken, waitReadable, mqAttach, mqReceive, mqReply},
+    {"socket", TRANSPORT_SOCKET, socketOpen, socketClose, socketPrepare, socketInherit, socketSend, socketPoll,
+     NULL, noToken, waitReadable, socketAttach, socketReceive, socketReply},
+    {"mpsc", TRANSPORT_MPSC, mpscOpen, mpscClose, mpscPrepare, NULL, futexSend, mpscPoll, mpscPollAny,
+     futexArm, futexWaitReply, mpscAttach, futexReceive, mpscReply},
+};
+
+#define TRANSPORT_COUNT (int)(sizeof(transports) / sizeof(transports[0]))
+
+const Transport *transportByName(const char *name) {
+    for (int i = 0; i < TRANSPORT_COUNT; i++) {
+        if (strcmp(transports[i].name, name) == 0) {
+            return &transports[i];
+        }
+    }
+    return NULL;
+}
+
+const Transport *transportById(int id) {
+    for (int i = 0; i < TRANSPORT_COUNT; i++) {
+        if (transports[i].id == id) {
+            return &transports[i];
+        }
+    }
+    return NULL;
+}
+
+const char *transportNames(void) {
+    return "sysv|ring|futex|mqueue|socket|mpsc";
+}
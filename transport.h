@@ -0,0 +1,61 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <sys/types.h>
+
+#include "shared.h"
+
+/* Workers started with the socket transport find their end of the socketpair here. */
+#define TRANSPORT_FD 3
+
+/*
+ * How oss and its workers exchange struct msgbuf. oss picks a backend with
+ * -m and records its id in the segment, and each worker picks the same one
+ * from there, so neither program touches an IPC API directly. Every backend
+ * but SysV gives each slot its own pair of channels; with SysV all slots
+ * share one queue and messages are told apart by mtype (see shared.h).
+ *
+ * Calls return -1 with errno set on failure. Optional entries are NULL when
+ * a backend has nothing better to offer and the caller falls back.
+ */
+typedef struct {
+    const char *name;
+    int id;
+
+    /* oss side */
+    int (*open)(SharedSegment *segment, int capacity);
+    void (*close)(void);
+    /* Fresh channels for a worker about to start in slot; runs before fork. */
+    void (*prepare)(int slot);
+    /* Optional: in the forked child, just before exec. */
+    void (*inherit)(int slot);
+    int (*send)(int slot, const struct msgbuf *msg);
+    /* Take slot's reply from worker pid without blocking: 1 if there was one, else 0. */
+    int (*poll)(int slot, pid_t pid, struct msgbuf *msg);
+    /*
+     * Optional: take a reply from any worker; the sender's pid is in mtype.
+     * With block set, wait for one instead of returning 0.
+     */
+    int (*pollAny)(struct msgbuf *msg, int block);
+    /*
+     * Optional: sleep until a reply may have arrived or timeoutNanos passes
+     * (0 waits as long as it takes). token comes from arm(), called before
+     * the caller last looked.
+     */
+    unsigned int (*arm)(void);
+    void (*wait)(unsigned int token, long timeoutNanos);
+
+    /* worker side */
+    int (*attach)(SharedSegment *segment, int slot);
+    int (*receive)(int slot, pid_t self, struct msgbuf *msg);
+    int (*reply)(int slot, const struct msgbuf *msg);
+} Transport;
+
+/* NULL if there is no backend by that name or id. */
+const Transport *transportByName(const char *name);
+const Transport *transportById(int id);
+
+/* Backend names for usage messages, e.g. "sysv|ring|futex|mqueue|socket". */
+const char *transportNames(void);
+
+#endif
@@ -0,0 +1,182 @@
+#include <stdlib.h>
+
+#include "wheel.h"
+
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+
+static int digit(long long tick, int level) {
+    return (int)((tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+}
+
+static int grow(TimingWheel *wheel) {
+    int capacity = wheel->capacity > 0 ? 2 * wheel->capacity : 16;
+    WheelTimer *timers = realloc(wheel->timers, capacity * sizeof(WheelTimer));
+    if (!timers) {
+        return -1;
+    }
+    for (int i = wheel->capacity; i < capacity; i++) {
+        timers[i].next = i + 1 < capacity ? i + 1 : -1;
+    }
+    wheel->freeList = wheel->capacity;
+    wheel->timers = timers;
+    wheel->capacity = capacity;
+    return 0;
+}
+
+static void release(TimingWheel *wheel, int index) {
+    wheel->timers[index].next = wheel->freeList;
+    wheel->freeList = index;
+}
+
+/* Link a timer into the lowest level whose window holds both it and now. */
+static void place(TimingWheel *wheel, int index) {
+    WheelTimer *timer = &wheel->timers[index];
+
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        int shift = WHEEL_BITS * (level + 1);
+        if ((timer->tick >> shift) == (wheel->now >> shift)) {
+            int d = digit(timer->tick, level);
+            timer->next = wheel->buckets[level][d];
+            wheel->buckets[level][d] = index;
+            wheel->occupied[level] |= 1ULL << d;
+            return;
+        }
+    }
+    timer->next = wheel->overflow;
+    wheel->overflow = index;
+}
+
+/* Unlink a whole list and place its live timers again against the current tick. */
+static void replace(TimingWheel *wheel, int head) {
+    while (head != -1) {
+        int next = wheel->timers[head].next;
+        if (wheel->live(wheel->timers[head].slot, wheel->timers[head].launchId)) {
+            place(wheel, head);
+        } else {
+            release(wheel, head);
+        }
+        head = next;
+    }
+}
+
+/*
+ * Make tick the current tick. Everything before it must already have gone
+ * off, so the only timers on the wrong level are those in the bucket tick
+ * now falls in on each upper level (and the overflow list, once tick leaves
+ * the top level's window); cascade those down, highest level first.
+ */
+static void moveTo(TimingWheel *wheel, long long tick) {
+    long long old = wheel->now;
+
+    wheel->now = tick;
+    if ((old >> (WHEEL_BITS * WHEEL_LEVELS)) != (tick >> (WHEEL_BITS * WHEEL_LEVELS))) {
+        int head = wheel->overflow;
+        wheel->overflow = -1;
+        replace(wheel, head);
+    }
+    for (int level = WHEEL_LEVELS - 1; level > 0; level--) {
+        int d = digit(tick, level);
+        if (wheel->occupied[level] & (1ULL << d)) {
+            int head = wheel->buckets[level][d];
+            wheel->buckets[level][d] = -1;
+            wheel->occupied[level] &= ~(1ULL << d);
+            replace(wheel, head);
+        }
+    }
+}
+
+/* Drop dead timers from a list and return the earliest tick left on it, or -1 if it is now empty. */
+static long long earliest(TimingWheel *wheel, int *head) {
+    long long best = -1;
+    int *link = head;
+
+    while (*link != -1) {
+        int index = *link;
+        WheelTimer *timer = &wheel->timers[index];
+        if (!wheel->live(timer->slot, timer->launchId)) {
+            *link = timer->next;
+            release(wheel, index);
+            continue;
+        }
+        if (best < 0 || timer->tick < best) {
+            best = timer->tick;
+        }
+        link = &timer->next;
+    }
+    return best;
+}
+
+int wheelInit(TimingWheel *wheel, int capacity, int (*live)(int slot, int launchId)) {
+    wheel->now = 0;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (int d = 0; d < WHEEL_SIZE; d++) {
+            wheel->buckets[level][d] = -1;
+        }
+        wheel->occupied[level] = 0;
+    }
+    wheel->overflow = -1;
+    wheel->timers = NULL;
+    wheel->capacity = 0;
+    wheel->freeList = -1;
+    wheel->live = live;
+    while (wheel->capacity < capacity) {
+        if (grow(wheel) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int wheelAdd(TimingWheel *wheel, long long tick, int slot, int launchId) {
+    if (wheel->freeList == -1 && grow(wheel) == -1) {
+        return -1;
+    }
+    int index = wheel->freeList;
+    wheel->freeList = wheel->timers[index].next;
+    wheel->timers[index].tick = tick > wheel->now ? tick : wheel->now;
+    wheel->timers[index].slot = slot;
+    wheel->timers[index].launchId = launchId;
+    place(wheel, index);
+    return 0;
+}
+
+long long wheelNext(TimingWheel *wheel) {
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        unsigned long long pending = wheel->occupied[level] & (~0ULL << digit(wheel->now, level));
+        while (pending) {
+            int d = __builtin_ctzll(pending);
+            long long tick = earliest(wheel, &wheel->buckets[level][d]);
+            if (tick >= 0) {
+                return tick;
+            }
+            wheel->occupied[level] &= ~(1ULL << d);
+            pending &= pending - 1;
+        }
+    }
+    return earliest(wheel, &wheel->overflow);
+}
+
+void wheelAdvance(TimingWheel *wheel, long long tick, void (*fire)(int slot, int launchId)) {
+    long long next;
+
+    while ((next = wheelNext(wheel)) != -1 && next <= tick) {
+        moveTo(wheel, next);
+        int d = digit(next, 0);
+        int head = wheel->buckets[0][d];
+        wheel->buckets[0][d] = -1;
+        wheel->occupied[0] &= ~(1ULL << d);
+        while (head != -1) {
+            int nextTimer = wheel->timers[head].next;
+            int slot = wheel->timers[head].slot;
+            int launchId = wheel->timers[head].launchId;
+            release(wheel, head);
+            if (wheel->live(slot, launchId)) {
+                fire(slot, launchId);
+            }
+            head = nextTimer;
+        }
+    }
+    if (tick > wheel->now) {
+        moveTo(wheel, tick);
+    }
+}
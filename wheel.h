@@ -0,0 +1,50 @@
+#ifndef WHEEL_H
+#define WHEEL_H
+
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 5
+
+/*
+ * Hierarchical timing wheel of per-slot timers, counted in whole ticks.
+ * Level 0 has a bucket for each tick of the current 64-tick window, level 1
+ * one for each 64-tick window of the current 4096 ticks, and so on; timers
+ * beyond the top level wait on an overflow list. A timer sits on the lowest
+ * level whose window also holds the current tick, so arming one is O(1) and
+ * moving to a later tick only redistributes the one bucket per level that
+ * the new tick falls in.
+ *
+ * Timers are never cancelled. live() says whether a timer's slot still has
+ * the same occupant; timers that don't are dropped as they are met.
+ */
+typedef struct {
+    long long tick;
+    int slot;
+    int launchId;
+    int next;
+} WheelTimer;
+
+typedef struct {
+    long long now;
+    int buckets[WHEEL_LEVELS][WHEEL_SIZE];
+    unsigned long long occupied[WHEEL_LEVELS];
+    int overflow;
+    WheelTimer *timers;
+    int capacity;
+    int freeList;
+    int (*live)(int slot, int launchId);
+} TimingWheel;
+
+/* An empty wheel at tick 0 with room for capacity timers; it grows as needed. Returns -1 if out of memory. */
+int wheelInit(TimingWheel *wheel, int capacity, int (*live)(int slot, int launchId));
+
+/* Arm a timer for slot at tick. Ticks already reached go off on the next wheelAdvance. Returns -1 if out of memory. */
+int wheelAdd(TimingWheel *wheel, long long tick, int slot, int launchId);
+
+/* Move on to tick, calling fire for each live timer due by then, earliest first. */
+void wheelAdvance(TimingWheel *wheel, long long tick, void (*fire)(int slot, int launchId));
+
+/* Tick of the earliest live timer, or -1 if none is armed. */
+long long wheelNext(TimingWheel *wheel);
+
+#endif
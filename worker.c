@@ -5,76 +5,189 @@
 #include <sys/ipc.h>
 #include <sys/msg.h>
 #include <sys/wait.h>
+#include <string.h>
 #include <time.h>
 
-#define SHM_KEY 12345
-#define MSG_KEY 54321
-#define MSG_SIZE sizeof(struct msgbuf) - sizeof(long)
+#include "shared.h"
+#include "stats.h"
+#include "trace.h"
+#include "transport.h"
+#include "workerloop.h"
 
-typedef struct {
-    int seconds;
-    int nanoseconds;
-} SharedClock;
+#define OUTPUT_BUFFER_SIZE 16384
 
-struct msgbuf {
-    long mtype;
-    int mtext;
-};
+SharedSegment *segment;
+SharedClock *simClock;
+const Transport *transport;
+int slot = -1;
+PayloadArena *arena;
+/* oss's live counters; workers still run if it can't be attached. */
+StatsSegment *stats;
 
-void run_worker(int maxSec, int maxNano) {
-    int shmid = shmget(SHM_KEY, sizeof(SharedClock), 0666);
-    if (shmid == -1) {
-        perror("shmget failed");
+/* Looked up once; they don't change while we run. */
+pid_t myPid;
+pid_t myPpid;
+
+/*
+ * Output is collected here and written in bulk, always on a line boundary,
+ * so workers sharing a terminal or pipe make far fewer writes and never
+ * split each other's lines.
+ */
+char outputBuffer[OUTPUT_BUFFER_SIZE];
+int outputLength;
+
+void flushOutput(void) {
+    int written = 0;
+    while (written < outputLength) {
+        ssize_t n = write(STDOUT_FILENO, outputBuffer + written, outputLength - written);
+        if (n <= 0) {
+            break;
+        }
+        written += n;
+    }
+    outputLength = 0;
+}
+
+/* Output lines for runWorker; NULL means the worker is done, so write everything out. */
+void output(WorkerContext *worker, const char *line, int length) {
+    if (!line) {
+        flushOutput();
+        return;
+    }
+    if (outputLength + length > OUTPUT_BUFFER_SIZE) {
+        flushOutput();
+    }
+    memcpy(outputBuffer + outputLength, line, length);
+    outputLength += length;
+}
+
+void receiveFromOss(struct msgbuf *msg) {
+    if (transport->receive(slot, myPid, msg) == -1) {
+        perror("receive failed");
         exit(EXIT_FAILURE);
     }
+}
+
+void sendToOss(struct msgbuf *msg) {
+    msg->mtype = myPid;
+    transport->reply(slot, msg);
+}
+
+/* Wait for oss's next tick: a message of our own, or a new epoch when oss broadcasts. */
+void waitForTick(WorkerContext *worker, struct msgbuf *msg) {
+    if (slot >= 0 && segment->broadcast) {
+        worker->epoch = tickWait(segment, worker->epoch);
+    } else {
+        receiveFromOss(msg);
+    }
+}
+
+void answerTick(WorkerContext *worker, struct msgbuf *msg) {
+    if (slot >= 0 && segment->broadcast) {
+        tickAnswer(segment, &segment->slots[slot].answer, worker->epoch, msg->mtext);
+    } else {
+        sendToOss(msg);
+    }
+}
+
+long long waitUntil(WorkerContext *worker, long long first, long long second) {
+    if (slot < 0) {
+        return clockWaitUntil(simClock, first, second);
+    }
+    return grantWait(simClock, &segment->slots[slot], first, second);
+}
+
+const WorkerOps processOps = {waitForTick, answerTick, waitUntil, output};
 
-    SharedClock *simClock = (SharedClock *)shmat(shmid, NULL, 0);
-    if (simClock == (void *)-1) {
+void attach(void) {
+    const char *shmidStr = getenv(SEGMENT_ENV);
+    if (!shmidStr) {
+        fprintf(stderr, "Error: %s is not set; workers are started by oss.\n", SEGMENT_ENV);
+        exit(EXIT_FAILURE);
+    }
+    int shmid = atoi(shmidStr);
+
+    segment = (SharedSegment *)shmat(shmid, NULL, 0);
+    if (segment == (void *)-1) {
         perror("shmat failed");
         exit(EXIT_FAILURE);
     }
+    simClock = &segment->clock;
+
+    if (segment->payloadBytes > 0) {
+        arena = (PayloadArena *)shmat(segment->arenaShmid, NULL, 0);
+        if (arena == (void *)-1) {
+            perror("shmat failed");
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    int msqid = msgget(MSG_KEY, 0666);
-    if (msqid == -1) {
-        perror("msgget failed");
+    if (segment->statsShmid != -1) {
+        stats = (StatsSegment *)shmat(segment->statsShmid, NULL, 0);
+        if (stats == (void *)-1) {
+            stats = NULL;
+        }
+    }
+
+    if (segment->traceDir[0] &&
+        traceOpen(segment->traceDir, TRACE_ROLE_WORKER, segment->ossPid, TRACE_WORKER_RECORDS) == -1) {
+        perror("traceOpen failed");
+    }
+
+    if (slot >= segment->capacity) {
+        fprintf(stderr, "Error: slot must be between 0 and %d.\n", segment->capacity - 1);
         exit(EXIT_FAILURE);
     }
 
-    int termSec = simClock->seconds + maxSec;
-    int termNano = simClock->nanoseconds + maxNano;
-    if (termNano >= 1000000000) {
-        termSec++;
-        termNano -= 1000000000;
+    /* Without a slot there are no per-slot channels, so stay on the shared SysV queue. */
+    transport = transportById(slot >= 0 ? segment->transport : TRANSPORT_SYSV);
+    if (!transport || transport->attach(segment, slot) == -1) {
+        perror("transport attach failed");
+        exit(EXIT_FAILURE);
     }
+}
 
-    printf("WORKER PID:%d PPID:%d SysClockS:%d SysClockNano:%d TermTimeS:%d TermTimeNano:%d --Just Starting\n",
-           getpid(), getppid(), simClock->seconds, simClock->nanoseconds, termSec, termNano);
+void run_worker(int maxSec, int maxNano) {
+    SlotStats *slotStats = stats && slot >= 0 && slot < stats->capacity ? &stats->slots[slot] : NULL;
+    WorkerContext worker = {&processOps, segment, arena, slot, myPid, myPpid, 0, slotStats};
+    runWorker(&worker, maxSec, maxNano);
+}
 
+/*
+ * Pool mode: stay attached and run one logical child after another, each
+ * time oss hands this slot a new assignment, until oss says to exit.
+ */
+void run_pool(void) {
     struct msgbuf msg;
-    int iterations = 0;
 
     do {
-        msgrcv(msqid, &msg, MSG_SIZE, getpid(), 0);
-        if (simClock->seconds > termSec || (simClock->seconds == termSec && simClock->nanoseconds >= termNano)) {
-            msg.mtext = 0;
-            msgsnd(msqid, &msg, MSG_SIZE, 0);
-            printf("WORKER PID:%d SysClockS:%d SysClockNano:%d TermTimeS:%d TermTimeNano:%d --Terminating after %d iterations\n",
-                   getpid(), simClock->seconds, simClock->nanoseconds, termSec, termNano, iterations);
-            break;
-        } else {
-            msg.mtext = 1;
-            msgsnd(msqid, &msg, MSG_SIZE, 0);
-            printf("WORKER PID:%d PPID:%d SysClockS:%d SysClockNano:%d TermTimeS:%d TermTimeNano:%d --%d iterations have passed since starting\n",
-                   getpid(), getppid(), simClock->seconds, simClock->nanoseconds, termSec, termNano, ++iterations);
+        receiveFromOss(&msg);
+        if (msg.mtext == MSG_ASSIGN) {
+            run_worker(segment->slots[slot].info.maxSec, segment->slots[slot].info.maxNano);
         }
-    } while (1);
-
-    shmdt(simClock);
+    } while (msg.mtext != MSG_EXIT);
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <maxSeconds> <maxNanoseconds>\n", argv[0]);
+    myPid = getpid();
+    myPpid = getppid();
+
+    if (argc == 3 && strcmp(argv[1], "-p") == 0) {
+        slot = atoi(argv[2]);
+        if (slot < 0) {
+            fprintf(stderr, "Error: slot must be a non-negative integer.\n");
+            return EXIT_FAILURE;
+        }
+        attach();
+        run_pool();
+        traceClose();
+        shmdt(segment);
+        return EXIT_SUCCESS;
+    }
+
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "Usage: %s <maxSeconds> <maxNanoseconds> [slot]\n", argv[0]);
+        fprintf(stderr, "       %s -p <slot>\n", argv[0]);
         return EXIT_FAILURE;
     }
 
@@ -85,6 +198,17 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
+    if (argc == 4) {
+        slot = atoi(argv[3]);
+        if (slot < 0) {
+            fprintf(stderr, "Error: slot must be a non-negative integer.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    attach();
     run_worker(maxSec, maxNano);
+    traceClose();
+    shmdt(segment);
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
\ No newline at end of file
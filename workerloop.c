@@ -0,0 +1,134 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "affinity.h"
+#include "trace.h"
+#include "workerloop.h"
+
+/* Sum of every payload byte read; kept so the reads can't be optimised away. */
+volatile unsigned long payloadChecksum;
+
+static void output(WorkerContext *worker, const char *format, ...) {
+    char line[WORKER_LINE_SIZE];
+    va_list args;
+
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    worker->ops->output(worker, line, n < (int)sizeof(line) ? n : (int)sizeof(line) - 1);
+}
+
+void consumePayload(WorkerContext *worker, const PayloadHandle *handle) {
+    const unsigned char *data = arenaData(worker->arena, handle);
+    unsigned long sum = 0;
+
+    if (!data) {
+        fprintf(stderr, "WORKER PID:%d received a stale payload handle\n", worker->pid);
+        exit(EXIT_FAILURE);
+    }
+    for (unsigned int i = 0; i < handle->length; i++) {
+        sum += data[i];
+    }
+    payloadChecksum += sum;
+    arenaRelease(worker->arena, handle);
+}
+
+void runWorker(WorkerContext *worker, int maxSec, int maxNano) {
+    SharedSegment *segment = worker->segment;
+    int slot = worker->slot;
+    long long now = clockRead(&segment->clock);
+    long long start = now;
+    if (slot >= 0) {
+        start = segment->slots[slot].info.startNanos;
+        worker->epoch = segment->slots[slot].info.startEpoch;
+    }
+
+    int termSec = clockSeconds(start) + maxSec;
+    int termNano = clockNanoseconds(start) + maxNano;
+    if (termNano >= 1000000000) {
+        termSec++;
+        termNano -= 1000000000;
+    }
+
+    traceEvent(TRACE_WORKER_START, slot, worker->pid, 0, now);
+    output(worker, "WORKER PID:%d PPID:%d SysClockS:%d SysClockNano:%d TermTimeS:%d TermTimeNano:%d --Just Starting\n",
+           worker->pid, worker->ppid, clockSeconds(now), clockNanoseconds(now), termSec, termNano);
+
+    struct msgbuf msg;
+    int iterations = 0;
+    int lastCpu = -1;
+    int outputEvery = segment->outputEvery;
+
+    long long term = termSec * NANOS_PER_SEC + termNano;
+
+    do {
+        long long waitStart = worker->stats ? statsNow() : 0;
+        worker->ops->waitForTick(worker, &msg);
+        if (worker->stats) {
+            statsAdd(&worker->stats->worker.ticks, 1);
+            statsAdd(&worker->stats->worker.receiveBlocked, statsNow() - waitStart);
+            int cpu = currentCpu();
+            if (cpu != lastCpu) {
+                if (lastCpu >= 0) {
+                    statsAdd(&worker->stats->worker.migrations, 1);
+                }
+                atomic_store_explicit(&worker->stats->worker.cpu, cpu, memory_order_relaxed);
+                lastCpu = cpu;
+            }
+        }
+        now = clockRead(&segment->clock);
+        traceEvent(TRACE_WORKER_RECEIVE, slot, worker->pid, 0, now);
+        if (!segment->broadcast && msg.payload.length > 0) {
+            consumePayload(worker, &msg.payload);
+        }
+
+        /*
+         * A grant of several ticks: wait for its last one (or termination),
+         * then account for every tick it covered as one iteration, with the
+         * same progress lines the worker would have printed tick by tick.
+         */
+        long long grantStart = now;
+        long long grantEnd = now;
+        if (slot >= 0 && !segment->broadcast) {
+            grantStart = segment->slots[slot].info.grantStart;
+            grantEnd = segment->slots[slot].info.grantEnd;
+        }
+        if (grantEnd > now) {
+            now = worker->ops->waitUntil(worker, grantEnd, term);
+        }
+        int terminating = now >= term;
+        int ran = terminating ? 0 : 1;
+        if (grantEnd > grantStart) {
+            ran += (now - grantStart) / segment->tickNanos;
+        }
+        msg.mtext = terminating ? 0 : 1;
+        msg.count = ran;
+        long long sendStart = worker->stats ? statsNow() : 0;
+        traceEvent(TRACE_WORKER_SEND, slot, worker->pid, msg.mtext, now);
+        worker->ops->answerTick(worker, &msg);
+        /*
+         * Once oss has the final answer it may hand the slot, counters and
+         * all, to the next worker, so that send goes uncounted.
+         */
+        if (worker->stats && !terminating) {
+            statsAdd(&worker->stats->worker.sendBlocked, statsNow() - sendStart);
+        }
+
+        for (int i = 0; i < ran; i++) {
+            long long tick = grantStart + (grantEnd > grantStart ? i * segment->tickNanos : 0);
+            iterations++;
+            if (outputEvery > 0 && iterations % outputEvery == 0) {
+                output(worker, "WORKER PID:%d PPID:%d SysClockS:%d SysClockNano:%d TermTimeS:%d TermTimeNano:%d --%d iterations have passed since starting\n",
+                       worker->pid, worker->ppid, clockSeconds(tick), clockNanoseconds(tick), termSec, termNano, iterations);
+            }
+        }
+        if (terminating) {
+            output(worker, "WORKER PID:%d SysClockS:%d SysClockNano:%d TermTimeS:%d TermTimeNano:%d --Terminating after %d iterations\n",
+                   worker->pid, clockSeconds(now), clockNanoseconds(now), termSec, termNano, iterations);
+            break;
+        }
+    } while (1);
+    traceEvent(TRACE_WORKER_EXIT, slot, worker->pid, iterations, clockRead(&segment->clock));
+    worker->ops->output(worker, NULL, 0);
+}
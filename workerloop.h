@@ -0,0 +1,46 @@
+#ifndef WORKERLOOP_H
+#define WORKERLOOP_H
+
+#include "shared.h"
+#include "stats.h"
+
+#define WORKER_LINE_SIZE 256
+
+/*
+ * One simulated process's life: wait for ticks, check the clock against its
+ * termination time, answer oss and print its progress lines. The worker
+ * program runs it as a real process and oss's fiber engine (-e fiber) runs
+ * it as a user-space task; everything that blocks or does I/O goes through
+ * ops, so both behave and print exactly alike.
+ */
+typedef struct WorkerContext WorkerContext;
+
+typedef struct {
+    /* Next tick from oss: a message of our own, or a new broadcast epoch. */
+    void (*waitForTick)(WorkerContext *worker, struct msgbuf *msg);
+    void (*answerTick)(WorkerContext *worker, struct msgbuf *msg);
+    /* Wait until the clock reaches either time and return it. */
+    long long (*waitUntil)(WorkerContext *worker, long long first, long long second);
+    /* One whole output line; called again with NULL once the worker is done. */
+    void (*output)(WorkerContext *worker, const char *line, int length);
+} WorkerOps;
+
+struct WorkerContext {
+    const WorkerOps *ops;
+    SharedSegment *segment;
+    PayloadArena *arena;
+    int slot;
+    pid_t pid;
+    pid_t ppid;
+    /* The broadcast epoch this worker last answered. */
+    unsigned int epoch;
+    /* The slot's counters in the stats segment, or NULL if there is none. */
+    SlotStats *stats;
+};
+
+void runWorker(WorkerContext *worker, int maxSec, int maxNano);
+
+/* Read a tick's payload where oss left it in the arena, then hand the block back. */
+void consumePayload(WorkerContext *worker, const PayloadHandle *handle);
+
+#endif